@@ -0,0 +1,209 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <glad/glad.h>
+
+#include <vector>
+#include <iostream>
+
+#include "json.hpp"
+using json = nlohmann::json;
+
+#include "shader.h"
+#include "simulation.h"
+
+
+// agent of a batched run, has to match the BATCHED agent struct in slimeFinal.comp
+struct batchedAgent {
+	float x;
+	float y;
+	float angle; // radians
+	unsigned int sim; // simulation (and trail layer) the agent belongs to
+};
+
+// per simulation data of a batched run, has to match batchInfoStruct in settings.glsl
+struct batchInfo {
+	unsigned int seed;
+	unsigned int firstAgent;
+};
+
+
+class slimeBatch
+{
+	// many small simulations with the same map size advanced together
+	// ----------------------------------------------------------------
+	// every simulation owns one layer of the trail and deposit array textures
+	// and one entry of the settings buffer, the agents of all of them share
+	// one buffer and carry their simulation index, so a step is a single
+	// diffusion dispatch and a single agent dispatch however many there are
+public:
+	unsigned int width = 0;
+	unsigned int height = 0;
+	unsigned int layers = 0;
+	unsigned int agentNumber = 0;
+
+	// simulation step counter, drives the random streams in the shaders
+	unsigned int frameIndex = 0;
+
+	unsigned int trailTextures[2] = {0, 0};
+	unsigned int depositTexture = 0;
+	int currentTrail = 0;
+
+	unsigned int settingsSSBO = 0;
+	unsigned int batchInfoSSBO = 0;
+	unsigned int agentDataSSBO = 0;
+
+	slimeBatch() {};
+
+	// sets up one simulation per preset, they all need the same map size,
+	// textures and buffers are reused when they are big enough
+	void load(const std::vector<json> &presets)
+	{
+		unsigned int newWidth = presets[0]["mapWidth"];
+		unsigned int newHeight = presets[0]["mapHeight"];
+		if (newWidth != width || newHeight != height || presets.size() != layers)
+			createTextures(newWidth, newHeight, presets.size());
+
+		// clear the trails and deposits left over from a previous batch
+		float trailClear[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+		glClearTexImage(trailTextures[0], 0, GL_RGBA, GL_FLOAT, trailClear);
+		glClearTexImage(trailTextures[1], 0, GL_RGBA, GL_FLOAT, trailClear);
+		glClearTexImage(depositTexture, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &depositClear);
+		currentTrail = 0;
+		frameIndex = 0;
+
+		std::vector<simulationSettings> settings;
+		std::vector<batchInfo> info;
+		std::vector<batchedAgent> agents;
+		std::vector<agent> simAgents;
+
+		for (unsigned int sim = 0; sim < presets.size(); sim++)
+		{
+			settings.push_back(readSimulationSettings(presets[sim]));
+
+			batchInfo simInfo;
+			simInfo.seed = presetSeed(presets[sim]);
+			simInfo.firstAgent = agents.size();
+			info.push_back(simInfo);
+
+			// spawn exactly like a single run of this preset would
+			unsigned int simAgentNumber = presets[sim]["agentNumber"];
+			simAgents.resize(simAgentNumber);
+			createAgents(presets[sim], width, height, simInfo.seed, simAgents.data());
+
+			for (const agent &a : simAgents)
+				agents.push_back({a.x, a.y, a.angle, sim});
+		}
+		agentNumber = agents.size();
+
+		uploadBuffer(settingsSSBO, settingsCapacity, settings.size() * sizeof(simulationSettings), settings.data());
+		uploadBuffer(batchInfoSSBO, batchInfoCapacity, info.size() * sizeof(batchInfo), info.data());
+		uploadBuffer(agentDataSSBO, agentCapacity, agents.size() * sizeof(batchedAgent), agents.data());
+	};
+
+	// one step of every simulation in the batch
+	void step(computeShader &diffuseShader, computeShader &agentShader)
+	{
+		// blur + decay every layer in one dispatch
+		// ----------------------------------------
+		diffuseShader.use();
+
+		glBindImageTexture(1, trailTextures[currentTrail], 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA32F);
+		glBindImageTexture(2, depositTexture, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+		glBindImageTexture(5, trailTextures[1 - currentTrail], 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, settingsSSBO);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, batchInfoSSBO);
+
+		// has to match the 8x8 local size in diffuse.comp
+		diffuseShader.dispatch((width + 7) / 8, (height + 7) / 8, layers);
+
+		// deposits are folded into the new trail now, clear them for the agents
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+		glClearTexImage(depositTexture, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &depositClear);
+		currentTrail = 1 - currentTrail;
+
+
+		// move the agents of every simulation in one dispatch
+		// ---------------------------------------------------
+		agentShader.use();
+
+		agentShader.setUint("frame", frameIndex++);
+
+		glBindImageTexture(1, trailTextures[currentTrail], 0, GL_TRUE, 0, GL_READ_ONLY, GL_RGBA32F);
+		glBindImageTexture(2, depositTexture, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, settingsSSBO);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, batchInfoSSBO);
+
+		// bind only the agents in use, a reused buffer can be bigger than that
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 4, agentDataSSBO, 0, agentNumber * sizeof(batchedAgent));
+
+		// has to match local_size_x in the compute shader
+		const int computeDivisor = 64;
+		agentShader.dispatch((agentNumber + computeDivisor - 1) / computeDivisor, 1);
+
+		glMemoryBarrier(GL_ALL_BARRIER_BITS);
+	};
+
+	// reads one simulation's trail back as width * height rgba floats (stalls, for offline use)
+	void readTrail(unsigned int layer, std::vector<float> &pixels)
+	{
+		pixels.resize((size_t)width * height * 4);
+		glGetTextureSubImage(trailTextures[currentTrail], 0, 0, 0, layer, width, height, 1,
+			GL_RGBA, GL_FLOAT, pixels.size() * sizeof(float), pixels.data());
+	};
+
+private:
+	size_t settingsCapacity = 0;
+	size_t batchInfoCapacity = 0;
+	size_t agentCapacity = 0;
+	unsigned int depositClear = 0;
+
+	void createTextures(unsigned int newWidth, unsigned int newHeight, unsigned int newLayers)
+	{
+		if (depositTexture != 0)
+		{
+			glDeleteTextures(2, trailTextures);
+			glDeleteTextures(1, &depositTexture);
+		}
+
+		width = newWidth;
+		height = newHeight;
+		layers = newLayers;
+
+		glGenTextures(2, trailTextures);
+		glGenTextures(1, &depositTexture);
+
+		for (int i = 0; i < 2; i++)
+		{
+			glBindTexture(GL_TEXTURE_2D_ARRAY, trailTextures[i]);
+			glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA32F, width, height, layers);
+		}
+
+		glBindTexture(GL_TEXTURE_2D_ARRAY, depositTexture);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R32UI, width, height, layers);
+
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	};
+
+	// uploads into buffer, only reallocating it when it is too small
+	void uploadBuffer(unsigned int &buffer, size_t &capacity, size_t size, const void *data)
+	{
+		if (buffer == 0)
+			glGenBuffers(1, &buffer);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		if (size <= capacity)
+		{
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, data);
+		}
+		else
+		{
+			glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_DYNAMIC_DRAW);
+			capacity = size;
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	};
+};
+#endif
@@ -0,0 +1,118 @@
+#ifndef CACHE_COUNTERS_H
+#define CACHE_COUNTERS_H
+
+#include <vector>
+#include <cstring>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "threadPool.h"
+
+class cacheCounters
+{
+	// L1 data cache and last level cache read misses of a thread pool
+	// ---------------------------------------------------------------
+	// hardware counters through perf_event_open (linux only), a counter only
+	// follows the thread that opened it, so every worker opens its own and
+	// the sums are read from here, without them (other systems, most
+	// virtual machines, perf_event_paranoid above 2) misses read as -1
+public:
+	cacheCounters(threadPool &pool)
+	{
+		descriptors.assign(pool.size() * eventCount, -1);
+
+		#ifdef __linux__
+		pool.run([this](int worker)
+		{
+			for (int event = 0; event < eventCount; event++)
+				descriptors[worker * eventCount + event] = open(event);
+		});
+		#endif
+	};
+
+	~cacheCounters()
+	{
+		#ifdef __linux__
+		for (int descriptor : descriptors)
+			if (descriptor >= 0)
+				close(descriptor);
+		#endif
+	};
+
+	cacheCounters(const cacheCounters&) = delete;
+	cacheCounters& operator=(const cacheCounters&) = delete;
+
+	// restarts counting from 0
+	void start()
+	{
+		#ifdef __linux__
+		for (int descriptor : descriptors)
+		{
+			if (descriptor >= 0)
+			{
+				ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+				ioctl(descriptor, PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+		#endif
+	};
+
+	// stops counting, misses since start() summed over all workers
+	void stop(long long &l1Misses, long long &lastLevelMisses)
+	{
+		long long sums[eventCount] = {};
+		bool counted[eventCount] = {};
+
+		#ifdef __linux__
+		for (size_t i = 0; i < descriptors.size(); i++)
+		{
+			int descriptor = descriptors[i];
+			if (descriptor < 0)
+				continue;
+
+			ioctl(descriptor, PERF_EVENT_IOC_DISABLE, 0);
+
+			long long count = 0;
+			if (read(descriptor, &count, sizeof(count)) == sizeof(count))
+			{
+				sums[i % eventCount] += count;
+				counted[i % eventCount] = true;
+			}
+		}
+		#endif
+
+		l1Misses = counted[0] ? sums[0] : -1;
+		lastLevelMisses = counted[1] ? sums[1] : -1;
+	};
+
+private:
+	static const int eventCount = 2;
+
+	// worker * eventCount + event
+	std::vector<int> descriptors;
+
+	#ifdef __linux__
+	// counter of the calling thread, on any CPU, user space only
+	static int open(int event)
+	{
+		perf_event_attr attributes;
+		memset(&attributes, 0, sizeof(attributes));
+		attributes.size = sizeof(attributes);
+		attributes.type = PERF_TYPE_HW_CACHE;
+		attributes.config = (event == 0 ? PERF_COUNT_HW_CACHE_L1D : PERF_COUNT_HW_CACHE_LL)
+			| PERF_COUNT_HW_CACHE_OP_READ << 8
+			| PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+		attributes.disabled = 1;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+
+		return (int)syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+	};
+	#endif
+};
+#endif
@@ -0,0 +1,215 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <iostream>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+class frameCapture
+{
+	// streams the displayed image to a file or stdout ("-") as raw rgb24 or y4m
+	// ---------------------------------------------------------------------------
+	// frames are read into a ring of pixel buffer objects and only mapped once
+	// their fence has signaled a few frames later, so glReadPixels never stalls
+public:
+	bool enabled = false;
+
+	frameCapture() {};
+
+	frameCapture(const std::string &outputPath, const std::string &outputFormat, int width, int height, int every, int ringSize, int fps)
+	{
+		this->width = width;
+		this->height = height;
+		this->every = std::max(1, every);
+		this->fps = std::max(1, fps);
+		y4m = (outputFormat == "y4m");
+
+		if (outputFormat != "y4m" && outputFormat != "rgb")
+		{
+			std::cout << "Unknown captureFormat: " << outputFormat << ", expected 'rgb' or 'y4m'." << std::endl;
+			return;
+		}
+
+		if (outputPath == "-")
+		{
+			#ifdef _WIN32
+			_setmode(_fileno(stdout), _O_BINARY);
+			#endif
+			file = stdout;
+
+			// keep text output from getting mixed into the frame stream
+			std::cout.rdbuf(std::cerr.rdbuf());
+		}
+		else
+		{
+			file = fopen(outputPath.c_str(), "wb");
+			if (file == NULL)
+			{
+				std::cout << "Couldn't open capture output: " << outputPath << std::endl;
+				return;
+			}
+		}
+
+		frameSize = width * height * 3;
+		pixels.resize(frameSize);
+		if (y4m)
+			planes.resize(frameSize);
+
+		slots.resize(std::max(2, ringSize));
+		for (pboSlot &slot : slots)
+		{
+			glGenBuffers(1, &slot.pbo);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+			glBufferData(GL_PIXEL_PACK_BUFFER, frameSize, NULL, GL_STREAM_READ);
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		if (y4m)
+			fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, this->fps);
+		else
+			std::cerr << "Capturing rgb24 " << width << "x" << height << ", e.g. pipe into: "
+				<< "ffmpeg -f rawvideo -pixel_format rgb24 -video_size " << width << "x" << height
+				<< " -framerate " << this->fps << " -i - out.mp4" << std::endl;
+
+		enabled = true;
+	};
+
+	// call once per presented frame, after drawing and before swapping buffers
+	void frame()
+	{
+		if (!enabled)
+			return;
+
+		// write out every readback that has already landed, without waiting
+		while (pending > 0 && writeOldest(false));
+
+		if (frameCounter++ % every != 0)
+			return;
+
+		// the ring is full, the oldest readback has to be written before reuse
+		if (pending == (int)slots.size())
+			writeOldest(true);
+
+		pboSlot &slot = slots[head];
+		head = (head + 1) % slots.size();
+		pending++;
+
+		// asynchronous readback, returns as soon as the copy is queued
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+		glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, 0);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	};
+
+	// writes all frames still in flight and closes the output
+	void finish()
+	{
+		if (!enabled)
+			return;
+
+		while (pending > 0)
+			writeOldest(true);
+
+		for (pboSlot &slot : slots)
+			glDeleteBuffers(1, &slot.pbo);
+
+		fflush(file);
+		if (file != stdout)
+			fclose(file);
+
+		enabled = false;
+	};
+
+private:
+	struct pboSlot {
+		unsigned int pbo = 0;
+		GLsync fence = 0;
+	};
+
+	std::vector<pboSlot> slots;
+	int head = 0;
+	int pending = 0;
+
+	int width = 0;
+	int height = 0;
+	int every = 1;
+	int fps = 60;
+	bool y4m = false;
+	unsigned long long frameCounter = 0;
+
+	size_t frameSize = 0;
+	std::vector<unsigned char> pixels;
+	std::vector<unsigned char> planes;
+	FILE *file = NULL;
+
+	bool writeOldest(bool wait)
+	{
+		pboSlot &slot = slots[(head + slots.size() - pending) % slots.size()];
+
+		GLuint64 timeout = wait ? 1000000000ull : 0;
+		GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+		if (status == GL_TIMEOUT_EXPIRED && !wait)
+			return false;
+
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+		pending--;
+
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+		void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameSize, GL_MAP_READ_BIT);
+		if (mapped != NULL)
+		{
+			// opengl rows start at the bottom, video rows at the top
+			const unsigned char *src = (const unsigned char*) mapped;
+			size_t rowSize = width * 3;
+			for (int row = 0; row < height; row++)
+				std::copy(src + (height - 1 - row) * rowSize, src + (height - row) * rowSize, pixels.begin() + row * rowSize);
+
+			glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+			writeFrame();
+		}
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		return true;
+	};
+
+	void writeFrame()
+	{
+		if (!y4m)
+		{
+			fwrite(pixels.data(), 1, frameSize, file);
+			return;
+		}
+
+		// planar 4:4:4 BT.601 studio range, what y4m consumers assume by default
+		size_t count = width * height;
+		unsigned char *yPlane = planes.data();
+		unsigned char *uPlane = yPlane + count;
+		unsigned char *vPlane = uPlane + count;
+		for (size_t i = 0; i < count; i++)
+		{
+			int r = pixels[i * 3 + 0];
+			int g = pixels[i * 3 + 1];
+			int b = pixels[i * 3 + 2];
+
+			yPlane[i] = (unsigned char)((( 66 * r + 129 * g +  25 * b + 128) >> 8) + 16);
+			uPlane[i] = (unsigned char)(((-38 * r -  74 * g + 112 * b + 128) >> 8) + 128);
+			vPlane[i] = (unsigned char)(((112 * r -  94 * g -  18 * b + 128) >> 8) + 128);
+		}
+
+		fputs("FRAME\n", file);
+		fwrite(planes.data(), 1, frameSize, file);
+	};
+};
+#endif
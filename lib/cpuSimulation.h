@@ -0,0 +1,1770 @@
+#ifndef CPU_SIMULATION_H
+#define CPU_SIMULATION_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <filesystem>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <malloc.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "json.hpp"
+using json = nlohmann::json;
+
+#include "simulation.h"
+#include "threadPool.h"
+#include "imageWrite.h"
+#include "cacheCounters.h"
+#include "numa.h"
+#include "taskGraph.h"
+
+
+// -----------------------------------------------------------------------------
+// memory
+// -----------------------------------------------------------------------------
+
+// rows start on cache line boundaries, which also lines them up for any vector width
+const size_t cacheLineBytes = 64;
+
+inline void *alignedAllocate(size_t bytes)
+{
+	#ifdef _WIN32
+	return _aligned_malloc(bytes, cacheLineBytes);
+	#else
+	void *memory = nullptr;
+	if (posix_memalign(&memory, cacheLineBytes, bytes) != 0)
+		return nullptr;
+	return memory;
+	#endif
+}
+
+inline void alignedFree(void *memory)
+{
+	#ifdef _WIN32
+	_aligned_free(memory);
+	#else
+	free(memory);
+	#endif
+}
+
+// size of the biggest CPU cache, maps whose trails don't fit in it are
+// written with non-temporal stores
+inline size_t lastLevelCacheBytes()
+{
+	size_t biggest = 0;
+
+	#if defined(_WIN32)
+	DWORD length = 0;
+	GetLogicalProcessorInformation(NULL, &length);
+	std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> caches(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+	if (!caches.empty() && GetLogicalProcessorInformation(caches.data(), &length))
+	{
+		for (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION &info : caches)
+			if (info.Relationship == RelationCache)
+				biggest = std::max(biggest, (size_t)info.Cache.Size);
+	}
+	#elif defined(_SC_LEVEL3_CACHE_SIZE)
+	long level3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+	long level2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+	biggest = (size_t)std::max(0L, std::max(level3, level2));
+	#endif
+
+	// a guess when the system doesn't say
+	return biggest > 0 ? biggest : 8u << 20;
+}
+
+// how the trail's pixels are ordered in memory
+enum class trailLayout {
+	rows, // row by row, see rowLayout
+	tiles // 8x8 pixel tiles, see tileLayout
+};
+
+class trailBuffer
+{
+	// single channel trail intensity, one float per pixel
+	// ---------------------------------------------------
+	// rows are padded to whole cache lines so rows never share a line
+	// (threads writing neighbouring bands don't fight over one) and vector
+	// loads and stores of a row line up with it, tiles pad the map to whole
+	// 64x64 pixel blocks instead
+public:
+	int width = 0;
+	int height = 0;
+	trailLayout layout = trailLayout::rows;
+
+	size_t stride = 0;      // rows: floats from one row to the next
+	int blockColumns = 0;   // tiles: 64x64 blocks per block row
+	size_t floats = 0;      // allocated, padding included
+	float *data = nullptr;
+
+	trailBuffer() {};
+
+	~trailBuffer()
+	{
+		alignedFree(data);
+	};
+
+	trailBuffer(const trailBuffer&) = delete;
+	trailBuffer& operator=(const trailBuffer&) = delete;
+
+	// new memory every time, none of it touched yet, so its pages end up on
+	// the NUMA node of the thread that first writes them
+	void resize(int newWidth, int newHeight, trailLayout newLayout)
+	{
+		alignedFree(data);
+
+		width = newWidth;
+		height = newHeight;
+		layout = newLayout;
+
+		if (layout == trailLayout::tiles)
+		{
+			blockColumns = (width + 63) / 64;
+			stride = 0;
+			floats = (size_t)blockColumns * ((height + 63) / 64) * 4096;
+		}
+		else
+		{
+			const size_t lineFloats = cacheLineBytes / sizeof(float);
+			blockColumns = 0;
+			stride = (width + lineFloats - 1) / lineFloats * lineFloats;
+			floats = stride * height;
+		}
+		data = (float*)alignedAllocate(floats * sizeof(float));
+	};
+
+	// clears rows [y0, y1), with tiles they have to be multiples of 64 (or
+	// the height), clearing up to the height also clears the padding
+	void clearRows(int y0, int y1)
+	{
+		memset(data + rowStart(y0), 0, (rowStart(y1) - rowStart(y0)) * sizeof(float));
+	};
+
+	// rows layout only
+	float *row(int y)
+	{
+		return data + y * stride;
+	};
+
+	const float *row(int y) const
+	{
+		return data + y * stride;
+	};
+
+	// where the memory of row y starts, rows [y0, y1) of the map are the
+	// floats [rowStart(y0), rowStart(y1)) as long as y0 and y1 are multiples
+	// of 64 (or the height) with tiles
+	size_t rowStart(int y) const
+	{
+		if (layout == trailLayout::tiles)
+			return (size_t)(y + 63) / 64 * blockColumns * 4096;
+		return y * stride;
+	};
+
+	// pixel at x, y of any layout, for code that isn't hot
+	float pixel(int x, int y) const;
+
+	// bytes of actual pixels, without the padding
+	size_t bytes() const
+	{
+		return (size_t)width * height * sizeof(float);
+	};
+
+	// the trail row by row without padding, bottom row first like the GPU trail
+	void read(std::vector<float> &intensity) const
+	{
+		intensity.resize((size_t)width * height);
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+				intensity[(size_t)y * width + x] = pixel(x, y);
+	};
+};
+
+// the layouts' pixel addressing, hot code takes them as template parameters
+// so the layout is picked once per pass instead of once per pixel
+// an offset is the sum of a part that only depends on the column and one
+// that only depends on the row, so loops over boxes work them out once per
+// column and row instead of once per pixel
+struct rowLayout {
+	static size_t column(const trailBuffer &, int x)
+	{
+		return x;
+	};
+
+	static size_t row(const trailBuffer &trail, int y)
+	{
+		return y * trail.stride;
+	};
+
+	static size_t offset(const trailBuffer &trail, int x, int y)
+	{
+		return row(trail, y) + column(trail, x);
+	};
+};
+
+struct tileLayout {
+	// 8x8 pixel tiles of 64 floats (four cache lines), rows inside a tile
+	// are 8 floats, the tiles are in Morton (Z) order inside 64x64 pixel
+	// blocks and the blocks row by row, so a sensor box lands on one or two
+	// tiles instead of one cache line per row and nearby tiles are nearby
+	// in memory, maps pad to 64 pixels instead of a power of two
+	// block, the x bits of the tile's Morton code and the column in the tile
+	static size_t column(const trailBuffer &, int x)
+	{
+		unsigned int tileX = (x >> 3) & 7;
+		unsigned int morton = (tileX & 1) | (tileX & 2) << 1 | (tileX & 4) << 2;
+		return (size_t)(x >> 6) << 12 | morton << 6 | (x & 7);
+	};
+
+	// block row, the y bits of the Morton code and the row in the tile
+	static size_t row(const trailBuffer &trail, int y)
+	{
+		unsigned int tileY = (y >> 3) & 7;
+		unsigned int morton = (tileY & 1) << 1 | (tileY & 2) << 2 | (tileY & 4) << 3;
+		return (size_t)(y >> 6) * trail.blockColumns << 12 | morton << 6 | (y & 7) << 3;
+	};
+
+	static size_t offset(const trailBuffer &trail, int x, int y)
+	{
+		return row(trail, y) + column(trail, x);
+	};
+};
+
+inline float trailBuffer::pixel(int x, int y) const
+{
+	if (layout == trailLayout::tiles)
+		return data[tileLayout::offset(*this, x, y)];
+	return data[rowLayout::offset(*this, x, y)];
+}
+
+
+// -----------------------------------------------------------------------------
+// diffusion kernel
+// -----------------------------------------------------------------------------
+
+// the kernels below round every product and sum on its own, contracting
+// them into fused multiply-adds (e.g. with -march=native) would only happen
+// in some of the paths and make rows, tiles and the vector code disagree
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// trail added per deposit, a fifth of full strength like depositedTrail() in
+// trail.glsl, deposit counts stop at 5 (more would add nothing)
+const float depositStrength = 0.2f;
+const int maxDepositCount = 5;
+
+// trail with count deposits added, trails never go over 1 so no deposits
+// give back the trail itself
+inline float depositedPixel(float trail, unsigned char count)
+{
+	return std::min(trail + depositStrength * count, 1.0f);
+}
+
+// same blur, mix and decay as diffuseTrail() in trail.glsl, on one channel
+struct diffuseParameters {
+	float keep;  // 1 - diffuse weight
+	float mix;   // diffuse weight
+	float decay;
+};
+
+// one pixel from the 3x3 neighbourhood around column x of the centre row,
+// left and right are the neighbouring columns (clamped at the map edges),
+// adds the columns up in the same order as the vector code so every path
+// gives the same result
+inline float diffusePixel(const float *above, const float *centre, const float *below,
+	int left, int x, int right, const diffuseParameters &parameters)
+{
+	float columnLeft = above[left] + centre[left] + below[left];
+	float columnCentre = above[x] + centre[x] + below[x];
+	float columnRight = above[right] + centre[right] + below[right];
+	float blurred = (columnLeft + columnCentre + columnRight) / 9.0f;
+
+	float value = centre[x] * parameters.keep + blurred * parameters.mix - parameters.decay;
+	return value > 0.0f ? value : 0.0f;
+}
+
+// columns [x0, x1) of one row, none of them on the left or right map edge so
+// their neighbours need no clamping, streaming writes around the caches
+template <bool streaming>
+inline void diffuseSpan(const float *above, const float *centre, const float *below, float *out,
+	int x0, int x1, const diffuseParameters &parameters)
+{
+	int x = x0;
+
+	#if defined(__AVX__)
+	const int lanes = 8;
+
+	// single pixels up to the first aligned output (out is cache line aligned)
+	for (; x < x1 && x % lanes != 0; x++)
+		out[x] = diffusePixel(above, centre, below, x - 1, x, x + 1, parameters);
+
+	const __m256 keep = _mm256_set1_ps(parameters.keep);
+	const __m256 mix = _mm256_set1_ps(parameters.mix);
+	const __m256 decay = _mm256_set1_ps(parameters.decay);
+	const __m256 nine = _mm256_set1_ps(9.0f);
+	const __m256 zero = _mm256_setzero_ps();
+
+	for (; x + lanes <= x1; x += lanes)
+	{
+		__m256 original = _mm256_load_ps(centre + x);
+
+		__m256 columnLeft = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(above + x - 1), _mm256_loadu_ps(centre + x - 1)), _mm256_loadu_ps(below + x - 1));
+		__m256 columnCentre = _mm256_add_ps(_mm256_add_ps(_mm256_load_ps(above + x), original), _mm256_load_ps(below + x));
+		__m256 columnRight = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(above + x + 1), _mm256_loadu_ps(centre + x + 1)), _mm256_loadu_ps(below + x + 1));
+		__m256 blurred = _mm256_div_ps(_mm256_add_ps(_mm256_add_ps(columnLeft, columnCentre), columnRight), nine);
+
+		__m256 value = _mm256_sub_ps(_mm256_add_ps(_mm256_mul_ps(original, keep), _mm256_mul_ps(blurred, mix)), decay);
+		value = _mm256_max_ps(value, zero);
+
+		if (streaming)
+			_mm256_stream_ps(out + x, value);
+		else
+			_mm256_store_ps(out + x, value);
+	}
+	#elif defined(__SSE2__) || defined(_M_X64)
+	const int lanes = 4;
+
+	for (; x < x1 && x % lanes != 0; x++)
+		out[x] = diffusePixel(above, centre, below, x - 1, x, x + 1, parameters);
+
+	const __m128 keep = _mm_set1_ps(parameters.keep);
+	const __m128 mix = _mm_set1_ps(parameters.mix);
+	const __m128 decay = _mm_set1_ps(parameters.decay);
+	const __m128 nine = _mm_set1_ps(9.0f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (; x + lanes <= x1; x += lanes)
+	{
+		__m128 original = _mm_load_ps(centre + x);
+
+		__m128 columnLeft = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(above + x - 1), _mm_loadu_ps(centre + x - 1)), _mm_loadu_ps(below + x - 1));
+		__m128 columnCentre = _mm_add_ps(_mm_add_ps(_mm_load_ps(above + x), original), _mm_load_ps(below + x));
+		__m128 columnRight = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(above + x + 1), _mm_loadu_ps(centre + x + 1)), _mm_loadu_ps(below + x + 1));
+		__m128 blurred = _mm_div_ps(_mm_add_ps(_mm_add_ps(columnLeft, columnCentre), columnRight), nine);
+
+		__m128 value = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(original, keep), _mm_mul_ps(blurred, mix)), decay);
+		value = _mm_max_ps(value, zero);
+
+		if (streaming)
+			_mm_stream_ps(out + x, value);
+		else
+			_mm_store_ps(out + x, value);
+	}
+	#endif
+
+	// what is left over (everything without SSE)
+	for (; x < x1; x++)
+		out[x] = diffusePixel(above, centre, below, x - 1, x, x + 1, parameters);
+}
+
+// columns diffused per pass down a band, the three input rows of such a
+// block (and the output row) stay in L1 while the block walks down, so
+// every trail row comes from memory once instead of three times
+const int diffuseBlockColumns = 1024;
+
+// diffuses rows [y0, y1) of in into out
+template <bool streaming>
+inline void diffuseRows(const trailBuffer &in, trailBuffer &out, int y0, int y1, const diffuseParameters &parameters)
+{
+	int width = in.width;
+	int height = in.height;
+
+	for (int blockStart = 0; blockStart < width; blockStart += diffuseBlockColumns)
+	{
+		int blockEnd = std::min(width, blockStart + diffuseBlockColumns);
+
+		for (int y = y0; y < y1; y++)
+		{
+			// the map edge rows clamp by reusing their own row, once per row
+			const float *above = in.row(std::max(y - 1, 0));
+			const float *centre = in.row(y);
+			const float *below = in.row(std::min(y + 1, height - 1));
+			float *target = out.row(y);
+
+			// only the first and last column clamp per pixel
+			if (blockStart == 0)
+				target[0] = diffusePixel(above, centre, below, 0, 0, std::min(1, width - 1), parameters);
+
+			diffuseSpan<streaming>(above, centre, below, target, std::max(blockStart, 1), std::min(blockEnd, width - 1), parameters);
+
+			if (blockEnd == width && width > 1)
+				target[width - 1] = diffusePixel(above, centre, below, width - 2, width - 1, width - 1, parameters);
+		}
+	}
+
+	#if defined(__SSE2__) || defined(_M_X64)
+	// non-temporal stores are weakly ordered, make them visible before the
+	// band counts as done
+	if (streaming)
+		_mm_sfence();
+	#endif
+}
+
+// diffuseRows() of the trail with deposits added, counts are laid out like
+// the trail and ring is room for 3 rows of it, the rows with deposits added
+// roll through it as the band is walked down, so the trail isn't changed
+template <bool streaming>
+inline void diffuseDepositedRows(const trailBuffer &in, const unsigned char *counts, trailBuffer &out, int y0, int y1,
+	const diffuseParameters &parameters, float *ring)
+{
+	int width = in.width;
+	int height = in.height;
+
+	auto deposited = [&](int y, float *row)
+	{
+		const float *trail = in.row(y);
+		const unsigned char *rowCounts = counts + in.rowStart(y);
+		for (int x = 0; x < width; x++)
+			row[x] = depositedPixel(trail[x], rowCounts[x]);
+	};
+
+	float *above = ring;
+	float *centre = ring + in.stride;
+	float *below = ring + 2 * in.stride;
+
+	deposited(std::max(y0 - 1, 0), above);
+	deposited(y0, centre);
+
+	for (int y = y0; y < y1; y++)
+	{
+		deposited(std::min(y + 1, height - 1), below);
+		float *target = out.row(y);
+
+		target[0] = diffusePixel(above, centre, below, 0, 0, std::min(1, width - 1), parameters);
+		diffuseSpan<streaming>(above, centre, below, target, 1, width - 1, parameters);
+		if (width > 1)
+			target[width - 1] = diffusePixel(above, centre, below, width - 2, width - 1, width - 1, parameters);
+
+		std::swap(above, centre);
+		std::swap(centre, below);
+	}
+
+	#if defined(__SSE2__) || defined(_M_X64)
+	if (streaming)
+		_mm_sfence();
+	#endif
+}
+
+// diffuses the 64x64 pixel blocks of rows [y0, y1) of a tiled trail, y0 and
+// y1 are multiples of 64 (or the height)
+// every tile is copied with a 1 pixel border (clamped to the map) into a
+// small row major scratch image first, the rows of which the row kernel
+// then diffuses, tiles are visited in memory order so both trails stream
+// counts (laid out like the trail) are deposits added to the trail on the
+// way into the scratch image, none without them
+template <bool streaming>
+inline void diffuseTiles(const trailBuffer &in, trailBuffer &out, int y0, int y1, const diffuseParameters &parameters,
+	const unsigned char *counts = nullptr)
+{
+	int width = in.width;
+	int height = in.height;
+
+	// scratch rows hold columns -1 to 8 of the tile at 7 to 16, so columns
+	// 0 to 7 line up with a vector
+	alignas(64) float scratch[10][24];
+
+	for (int blockY = y0; blockY < y1; blockY += 64)
+	{
+		for (int blockX = 0; blockX < width; blockX += 64)
+		{
+			for (unsigned int morton = 0; morton < 64; morton++)
+			{
+				int originX = blockX + 8 * (int)((morton & 1) | (morton >> 1 & 2) | (morton >> 2 & 4));
+				int originY = blockY + 8 * (int)((morton >> 1 & 1) | (morton >> 2 & 2) | (morton >> 3 & 4));
+
+				// padding tiles outside the map
+				if (originX >= width || originY >= height)
+					continue;
+
+				// a tile row is 8 floats in a row unless the map ends inside it
+				bool whole = originX + 8 <= width;
+				size_t centre = tileLayout::column(in, originX);
+				size_t left = tileLayout::column(in, std::max(0, originX - 1));
+				size_t right = tileLayout::column(in, std::min(width - 1, originX + 8));
+
+				for (int row = 0; row < 10; row++)
+				{
+					size_t rowOffset = tileLayout::row(in, std::min(height - 1, std::max(0, originY + row - 1)));
+					const float *source = in.data + rowOffset;
+
+					if (whole)
+						memcpy(&scratch[row][8], source + centre, 8 * sizeof(float));
+					else
+						for (int column = 0; column < 8; column++)
+							scratch[row][8 + column] = source[tileLayout::column(in, std::min(width - 1, originX + column))];
+
+					scratch[row][7] = source[left];
+					scratch[row][16] = source[right];
+
+					if (counts != nullptr)
+					{
+						const unsigned char *rowCounts = counts + rowOffset;
+						for (int column = 0; column < 8; column++)
+							scratch[row][8 + column] = depositedPixel(scratch[row][8 + column], rowCounts[tileLayout::column(in, std::min(width - 1, originX + column))]);
+
+						scratch[row][7] = depositedPixel(scratch[row][7], rowCounts[left]);
+						scratch[row][16] = depositedPixel(scratch[row][16], rowCounts[right]);
+					}
+				}
+
+				float *tile = &out.data[tileLayout::offset(out, originX, originY)];
+				for (int row = 0; row < 8; row++)
+					diffuseSpan<streaming>(&scratch[row][8], &scratch[row + 1][8], &scratch[row + 2][8], tile + 8 * row, 0, 8, parameters);
+			}
+		}
+	}
+
+	#if defined(__SSE2__) || defined(_M_X64)
+	if (streaming)
+		_mm_sfence();
+	#endif
+}
+
+// diffuseTiles() with deposits, called like diffuseDepositedRows() (tiles
+// need no ring)
+template <bool streaming>
+inline void diffuseDepositedTiles(const trailBuffer &in, const unsigned char *counts, trailBuffer &out, int y0, int y1,
+	const diffuseParameters &parameters, float * /*ring*/)
+{
+	diffuseTiles<streaming>(in, out, y0, y1, parameters, counts);
+}
+
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT DEFAULT
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+// -----------------------------------------------------------------------------
+// agents
+// -----------------------------------------------------------------------------
+
+// the same random numbers as hash() and uintToRange01() in slimeFinal.comp
+inline unsigned int agentHash(unsigned int state)
+{
+	state ^= 2747636419u;
+	state *= 2654435769u;
+	state ^= state >> 16;
+	state *= 2654435769u;
+	state ^= state >> 16;
+	state *= 2654435769u;
+	return state;
+}
+
+inline float agentRandomUnit(unsigned int state)
+{
+	return state / 4294967295.f;
+}
+
+// sensor radius of the agent kernels that read it from the settings, the
+// others have it fixed at compile time, see CPU_SENSOR_SIZES
+const int anySensorSize = -1;
+
+// trail intensity summed over the sensor box, clamped to the map
+template <typename layout, int sensorSize>
+inline float senseTrail(const trailBuffer &trail, const simulationSettings &settings, const agent &current, float angleOffset)
+{
+	static_assert(sensorSize < 32, "sensor boxes are at most 64 pixels wide");
+	const int radius = sensorSize == anySensorSize ? settings.sensorSize : sensorSize;
+
+	float sensorAngle = current.angle + angleOffset;
+	int centreX = int(current.x + std::cos(sensorAngle) * settings.sensorDistance);
+	int centreY = int(current.y + std::sin(sensorAngle) * settings.sensorDistance);
+
+	float sum = 0;
+
+	// boxes wider than the column table (only radii read from the settings)
+	// clamp every pixel on its own
+	const int maxBoxWidth = 64;
+	int boxWidth = 2 * radius + 1;
+	if (boxWidth > maxBoxWidth)
+	{
+		for (int offsetY = -radius; offsetY <= radius; offsetY++)
+		{
+			int y = std::min(settings.height - 1, std::max(0, centreY + offsetY));
+			for (int offsetX = -radius; offsetX <= radius; offsetX++)
+				sum += trail.data[layout::offset(trail, std::min(settings.width - 1, std::max(0, centreX + offsetX)), y)];
+		}
+		return sum;
+	}
+
+	// column parts of the box's offsets, shared by its rows
+	size_t columns[maxBoxWidth];
+	for (int i = 0; i < boxWidth; i++)
+		columns[i] = layout::column(trail, std::min(settings.width - 1, std::max(0, centreX - radius + i)));
+
+	for (int offsetY = -radius; offsetY <= radius; offsetY++)
+	{
+		const float *row = trail.data + layout::row(trail, std::min(settings.height - 1, std::max(0, centreY + offsetY)));
+		for (int i = 0; i < boxWidth; i++)
+			sum += row[columns[i]];
+	}
+	return sum;
+}
+
+// one agent step like slimeFinal.comp (angle headings, taps sensing): sense,
+// steer, move and bounce off the map edges, random is the agent's number
+// for this step
+template <typename layout, int sensorSize>
+inline void moveAgent(const trailBuffer &trail, const simulationSettings &settings, agent &current, unsigned int random)
+{
+	float senseForward = senseTrail<layout, sensorSize>(trail, settings, current, 0);
+	float senseLeft = senseTrail<layout, sensorSize>(trail, settings, current, settings.sensorAngle);
+	float senseRight = senseTrail<layout, sensorSize>(trail, settings, current, -settings.sensorAngle);
+
+	float randomSteerStrength = agentRandomUnit(agentHash(random));
+	float turnSpeed = settings.turnSpeed;
+
+	float turn;
+	if (senseForward == 0 && senseRight == 0 && senseLeft == 0)
+		turn = (randomSteerStrength - 0.5f) * 2 * turnSpeed;
+	else if (senseForward > senseLeft && senseForward > senseRight)
+		turn = 0;
+	else if (senseForward < senseLeft && senseForward < senseRight)
+		turn = (randomSteerStrength - 0.5f) * 2 * turnSpeed;
+	else if (senseLeft > senseRight)
+		turn = randomSteerStrength * turnSpeed;
+	else if (senseLeft < senseRight)
+		turn = -(randomSteerStrength * turnSpeed);
+	else
+		turn = (randomSteerStrength - 0.5f) * 2 * turnSpeed;
+
+	current.angle += turn;
+	current.x += settings.moveSpeed * std::cos(current.angle);
+	current.y += settings.moveSpeed * std::sin(current.angle);
+
+	if (current.x <= 0 || current.x >= settings.width || current.y <= 0 || current.y >= settings.height)
+	{
+		current.x = std::min((float)settings.width - 1, std::max(0.0f, current.x));
+		current.y = std::min((float)settings.height - 1, std::max(0.0f, current.y));
+		current.angle = agentRandomUnit(agentHash(random)) * 2 * (float)M_PI;
+	}
+}
+
+// adds value to a shared float with a compare and swap loop
+inline void atomicAdd(std::atomic<float> &target, float value)
+{
+	float expected = target.load(std::memory_order_relaxed);
+	while (!target.compare_exchange_weak(expected, expected + value, std::memory_order_relaxed))
+	{
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+// simulation
+// -----------------------------------------------------------------------------
+
+// how the agents' deposits get into the trail
+enum class depositMethod {
+	accumulate, // per worker pixel lists, merged band by band without atomics
+	atomic      // one shared float per pixel, every deposit is an atomic add
+};
+
+// sensor radii the agent kernels get their own instantiations for, set at
+// build time (e.g. -DCPU_SENSOR_SIZES=1 for a smaller binary), presets with
+// any other radius run the kernels that read it from the settings
+#ifndef CPU_SENSOR_SIZES
+#define CPU_SENSOR_SIZES 0, 1, 2
+#endif
+
+// seconds spent in each part of the steps since the last reset, fused
+// steps count the pass over the bins as agents, the bins diffused after it
+// as diffuse and sorting the agents into their new bins as merge, with
+// work stealing the parts overlap and are the time their tasks took
+// summed over the threads, divided by the thread count
+struct cpuStepTimes {
+	double merge = 0;
+	double diffuse = 0;
+	double agents = 0;
+	double total = 0;
+	int steps = 0;
+};
+
+// how the workers share a step
+enum class cpuScheduler {
+	phases,  // every part of the step is split evenly over the workers, with a barrier after each
+	stealing // small tasks run as soon as their inputs are done, idle workers steal them
+};
+
+class cpuSimulation
+{
+	// a slime simulation on the CPU
+	// -----------------------------
+	// for nodes without a GPU, the trail is single channel intensity like on
+	// tiled maps and colored when it's shown, ping-ponged between two buffers
+	// like the GPU textures, a step follows the GPU one: the deposits of the
+	// last agent pass go into the trail, the trail is diffused and the agents
+	// sense it, move and deposit again
+	// every worker of the pool diffuses and merges deposits into its own band
+	// of rows and moves its own share of the agents, where they end up is
+	// random, so workers never write to a shared pixel:
+	// accumulate - every worker lists the pixels its agents deposit on, one
+	//              list per band, then every band's owner counts the lists
+	//              for its band and adds the counts to the trail, no atomics
+	//              and nothing written by two workers, even when all agents
+	//              sit on one pixel (centre spawns)
+	// atomic     - every deposit is an atomic add to a shared float per
+	//              pixel, added to the trail by the band owners, kept to
+	//              compare against, agents on the same pixels serialize on
+	//              the same cache line
+	// the trail is stored row by row or in tiles ("trailLayout": "tiles"),
+	// with tiles the bands are whole 64 pixel block rows
+	// with "numaPlacement" (the default) the workers are pinned to CPUs, node
+	// after node, and every worker first touches its own bands and agents so
+	// their pages land on its node, otherwise this thread touches everything
+	// (all of it lands on one node) and the workers run wherever
+	// "fusedStep" streams the trail through memory about once per step
+	// instead of twice (once for the agents, once for diffusion), see
+	// fusedStep()
+	// "scheduler": "stealing" runs several steps as one graph of tasks, see
+	// runGraph()
+public:
+	int width = 0;
+	int height = 0;
+	simulationSettings settings;
+	unsigned int seed = 0;
+	unsigned int frameIndex = 0;
+
+	trailBuffer trails[2];
+	int currentTrail = 0;
+
+	std::unique_ptr<agent[]> agents;
+	size_t agentCount = 0;
+
+	trailLayout layout = trailLayout::rows;
+	depositMethod deposit = depositMethod::accumulate;
+
+	// non-temporal stores for the diffused trail, by default when both
+	// trails together don't fit in the last level cache (the next step would
+	// find the rows evicted anyway, so writing them around the cache saves
+	// reading every line before overwriting it)
+	bool streaming = false;
+
+	bool numa = true;
+
+	bool fused = false;
+
+	cpuScheduler scheduler = cpuScheduler::phases;
+
+	// the agent kernels have the preset's sensor radius built in, false
+	// when it isn't one of CPU_SENSOR_SIZES
+	bool specializedSensing = false;
+
+	cpuStepTimes times;
+
+	cpuSimulation(threadPool &pool)
+		: pool(pool)
+	{
+	};
+
+	void load(const json &preset)
+	{
+		settings = readSimulationSettings(preset);
+		width = settings.width;
+		height = settings.height;
+		seed = presetSeed(preset);
+		frameIndex = 0;
+
+		numa = preset.value("numaPlacement", true);
+		placeWorkers();
+
+		scheduler = preset.value("scheduler", "phases") == "stealing" ? cpuScheduler::stealing : cpuScheduler::phases;
+
+		layout = preset.value("trailLayout", "rows") == "tiles" ? trailLayout::tiles : trailLayout::rows;
+		for (trailBuffer &trail : trails)
+			trail.resize(width, height, layout);
+		currentTrail = 0;
+
+		const json &stores = preset.value("streamingStores", json("auto"));
+		if (stores.is_boolean())
+			streaming = stores;
+		else
+			streaming = 2 * trails[0].bytes() > lastLevelCacheBytes();
+
+		// agents have to move less than a bin minus the pixel the blur reaches
+		fused = preset.value("fusedStep", false);
+		if (fused && settings.moveSpeed >= binRows - 2)
+		{
+			std::cout << "Fused steps need a moveSpeed below " << binRows - 2 << ", running unfused steps." << std::endl;
+			fused = false;
+		}
+
+		// fused steps have their own order, one pass and a sort per step
+		if (fused)
+			scheduler = cpuScheduler::phases;
+
+		// spawned in one random sequence here, then copied into memory nobody touched yet
+		std::vector<agent> spawned(preset["agentNumber"].get<unsigned int>());
+		createAgents(preset, width, height, seed, spawned.data());
+		agentCount = spawned.size();
+		agents.reset(new agent[agentCount]);
+
+		deposit = preset.value("deposit", "accumulate") == "atomic" ? depositMethod::atomic : depositMethod::accumulate;
+		selectKernels();
+		resetDeposits();
+
+		// fused steps keep the agents sorted by bin, with their spawn index
+		// along for their random numbers
+		std::vector<unsigned int> spawnIndices;
+		if (fused)
+			binAgents(spawned, spawnIndices);
+
+		auto firstTouch = [&](int worker)
+		{
+			for (trailBuffer &trail : trails)
+				trail.clearRows(bandStart[worker], bandStart[worker + 1]);
+
+			size_t first = agentRange(worker);
+			size_t last = agentRange(worker + 1);
+			std::copy(spawned.begin() + first, spawned.begin() + last, agents.get() + first);
+
+			size_t firstPixel = trails[0].rowStart(bandStart[worker]);
+			size_t lastPixel = trails[0].rowStart(bandStart[worker + 1]);
+
+			if (fused)
+			{
+				std::copy(spawnIndices.begin() + first, spawnIndices.begin() + last, agentIds.get() + first);
+				std::copy(spawned.begin() + first, spawned.begin() + last, spareAgents.get() + first);
+				std::copy(spawnIndices.begin() + first, spawnIndices.begin() + last, spareIds.get() + first);
+
+				for (std::unique_ptr<unsigned char[]> &counts : fusedCounts)
+					memset(counts.get() + firstPixel, 0, lastPixel - firstPixel);
+				if (layout == trailLayout::rows)
+					diffusionRings[worker].clearRows(0, 3);
+			}
+			else if (deposit == depositMethod::atomic)
+			{
+				for (size_t pixel = firstPixel; pixel < lastPixel; pixel++)
+					depositSums[pixel].store(0, std::memory_order_relaxed);
+			}
+			else
+			{
+				memset(depositCounts.get() + firstPixel, 0, lastPixel - firstPixel);
+			}
+		};
+
+		if (numa)
+			pool.run(firstTouch);
+		else
+			for (int worker = 0; worker < pool.size(); worker++)
+				firstTouch(worker);
+
+		times = cpuStepTimes();
+	};
+
+	// one simulation step, see above
+	void step()
+	{
+		if (fused)
+		{
+			fusedStep();
+			return;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		mergeDeposits();
+		auto merged = std::chrono::steady_clock::now();
+		diffuse();
+		auto diffused = std::chrono::steady_clock::now();
+		moveAgents();
+		auto moved = std::chrono::steady_clock::now();
+
+		times.merge += std::chrono::duration<double>(merged - start).count();
+		times.diffuse += std::chrono::duration<double>(diffused - merged).count();
+		times.agents += std::chrono::duration<double>(moved - diffused).count();
+		times.total += std::chrono::duration<double>(moved - start).count();
+		times.steps++;
+	};
+
+	// steps simulation steps, as one task graph with work stealing
+	void run(int steps)
+	{
+		if (scheduler == cpuScheduler::stealing && !fused)
+		{
+			runGraph(steps);
+			return;
+		}
+
+		for (int step = 0; step < steps; step++)
+			this->step();
+	};
+
+	// work stealing
+	// -------------
+	// the steps are one graph of small tasks: agent chunks (several per
+	// worker), then merging the deposits and diffusing band by band, a task
+	// starts as soon as what it reads is written, not when the whole part
+	// of the step before it is:
+	// merge band b      - every agent chunk of the step before (they deposit
+	//                     anywhere and sense the trail merged into)
+	// diffuse band b    - merging band b and the bands next to it (it reads
+	//                     their edge rows)
+	// agent chunk c     - every band diffused (agents sense anywhere)
+	// agent chunks differ in cost (crowded agents sense the same cached
+	// pixels, lonely ones miss), workers that finish early steal the rest
+	// instead of waiting, the same trails come out as with phases
+	void runGraph(int steps)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		int workers = pool.size();
+		int chunks = (int)depositLists.size();
+		std::vector<double> taskTimes((size_t)workers * 3, 0.0);
+
+		// seconds of work on every worker, for the part it's part of
+		auto timed = [&taskTimes](int part, std::function<void()> work)
+		{
+			return [&taskTimes, part, work](int worker)
+			{
+				auto begin = std::chrono::steady_clock::now();
+				work();
+				taskTimes[(size_t)worker * 3 + part] += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			};
+		};
+
+		taskGraph graph;
+		std::vector<int> lastAgents;
+		for (int step = 0; step < steps; step++)
+		{
+			int trail = currentTrail;
+			unsigned int frameSeed = agentHash(frameIndex++ + agentHash(seed));
+			currentTrail = 1 - currentTrail;
+
+			std::vector<int> merges(workers);
+			for (int band = 0; band < workers; band++)
+			{
+				merges[band] = graph.add(timed(0, [this, trail, band]() { mergeBand(trails[trail], band); }));
+				for (int input : lastAgents)
+					graph.depend(merges[band], input);
+			}
+
+			std::vector<int> diffusions(workers);
+			for (int band = 0; band < workers; band++)
+			{
+				diffusions[band] = graph.add(timed(1, [this, trail, band]()
+				{
+					kernels.diffuse(trails[trail], trails[1 - trail], bandStart[band], bandStart[band + 1], diffusion());
+				}));
+				// its own rows and the ones just outside (tiled bands can be empty)
+				int y0 = bandStart[band];
+				int y1 = bandStart[band + 1];
+				graph.depend(diffusions[band], merges[band]);
+				if (y0 < y1 && y0 > 0)
+					graph.depend(diffusions[band], merges[bandOfRow[y0 - 1]]);
+				if (y0 < y1 && y1 < height)
+					graph.depend(diffusions[band], merges[bandOfRow[y1]]);
+			}
+
+			lastAgents.assign(chunks, 0);
+			for (int chunk = 0; chunk < chunks; chunk++)
+			{
+				size_t first = agentCount * chunk / chunks;
+				size_t last = agentCount * (chunk + 1) / chunks;
+				lastAgents[chunk] = graph.add(timed(2, [this, trail, frameSeed, first, last, chunk]()
+				{
+					(this->*kernels.moveAgents)(trails[1 - trail], frameSeed, first, last, depositLists[chunk]);
+				}));
+				for (int input : diffusions)
+					graph.depend(lastAgents[chunk], input);
+			}
+		}
+
+		graph.run(pool);
+		auto finished = std::chrono::steady_clock::now();
+
+		for (int worker = 0; worker < workers; worker++)
+		{
+			times.merge += taskTimes[(size_t)worker * 3] / workers;
+			times.diffuse += taskTimes[(size_t)worker * 3 + 1] / workers;
+			times.agents += taskTimes[(size_t)worker * 3 + 2] / workers;
+		}
+		times.total += std::chrono::duration<double>(finished - start).count();
+		times.steps += steps;
+	};
+
+	// fused step
+	// ----------
+	// the map is cut into bins of 64 rows, every worker owns consecutive
+	// bins (its band) and the agents are kept sorted by bin, so a worker
+	// walks down its band moving the agents of one bin after the other: they
+	// sense the trail, move and count their deposits, then the bin two
+	// behind gets diffused with the deposits added, the trail rows it reads
+	// were just pulled into the cache by the agents around them
+	// agents move less than a bin, so a bin only gets deposits from the bins
+	// next to it, and its diffusion only needs them (and the rows next to
+	// it), the bins at the edges of a band wait for the neighbouring bands:
+	// deposits into them are listed and counted, and the bins diffused, once
+	// every worker is done, last the agents are sorted into their new bins
+	// agents sense the trail before the step's deposits, which the diffusion
+	// adds on the fly, so after n fused steps the trail is the trail of n
+	// unfused steps with their last deposits added and diffused
+	void fusedStep()
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		diffuseParameters parameters = diffusion();
+		const trailBuffer &in = trails[currentTrail];
+		trailBuffer &out = trails[1 - currentTrail];
+
+		// this step's deposit counts, last step's get cleared bin by bin
+		unsigned char *counts = fusedCounts[frameIndex & 1].get();
+		unsigned char *lastCounts = fusedCounts[(frameIndex + 1) & 1].get();
+		unsigned int frameSeed = agentHash(frameIndex++ + agentHash(seed));
+
+		auto diffuseBin = [&](int worker, int bin)
+		{
+			int y0 = bin * binRows;
+			int y1 = std::min(height, y0 + binRows);
+			kernels.diffuseDeposited(in, counts, out, y0, y1, parameters, diffusionRings[worker].data);
+
+			size_t first = in.rowStart(y0);
+			memset(lastCounts + first, 0, in.rowStart(y1) - first);
+		};
+
+		pool.run([&](int worker)
+		{
+			(this->*kernels.moveBinnedAgents)(worker, counts, frameSeed, diffuseBin);
+		});
+		auto moved = std::chrono::steady_clock::now();
+
+		// edge bins read the neighbouring regions' edge bins, so all of the
+		// listed deposits go in before any of them is diffused
+		int workers = pool.size();
+		pool.run([&](int worker)
+		{
+			for (int other = 0; other < workers; other++)
+				for (unsigned int pixel : edgeDeposits[other][worker])
+					counts[pixel] = std::min(counts[pixel] + 1, maxDepositCount);
+		});
+		pool.run([&](int worker)
+		{
+			int first = regionStart[worker];
+			int end = regionStart[worker + 1];
+			for (int bin = first; bin < end; bin++)
+				if (!innerBin(bin, first, end))
+					diffuseBin(worker, bin);
+		});
+		currentTrail = 1 - currentTrail;
+		auto diffused = std::chrono::steady_clock::now();
+
+		sortBinnedAgents();
+		auto sorted = std::chrono::steady_clock::now();
+
+		times.agents += std::chrono::duration<double>(moved - start).count();
+		times.diffuse += std::chrono::duration<double>(diffused - moved).count();
+		times.merge += std::chrono::duration<double>(sorted - diffused).count();
+		times.total += std::chrono::duration<double>(sorted - start).count();
+		times.steps++;
+	};
+
+	// blur + decay the trail into the other buffer, which becomes the trail
+	void diffuse()
+	{
+		diffuseParameters parameters = diffusion();
+
+		const trailBuffer &in = trails[currentTrail];
+		trailBuffer &out = trails[1 - currentTrail];
+
+		pool.run([&](int worker)
+		{
+			kernels.diffuse(in, out, bandStart[worker], bandStart[worker + 1], parameters);
+		});
+
+		currentTrail = 1 - currentTrail;
+	};
+
+	// every agent senses the trail, moves and deposits
+	void moveAgents()
+	{
+		const trailBuffer &trail = trails[currentTrail];
+		unsigned int frameSeed = agentHash(frameIndex++ + agentHash(seed));
+
+		pool.run([&](int worker)
+		{
+			(this->*kernels.moveAgents)(trail, frameSeed, agentRange(worker), agentRange(worker + 1), depositLists[worker]);
+		});
+	};
+
+	// adds the last agent pass's deposits to the trail, like depositedTrail()
+	// in trail.glsl: a fifth of full strength per deposit, at most full
+	void mergeDeposits()
+	{
+		pool.run([&](int band)
+		{
+			mergeBand(trails[currentTrail], band);
+		});
+	};
+
+	// mergeDeposits() of one band
+	void mergeBand(trailBuffer &trail, int band)
+	{
+		if (deposit == depositMethod::atomic)
+		{
+			// the band's memory, padding included (which never gets deposits)
+			size_t last = trail.rowStart(bandStart[band + 1]);
+			for (size_t pixel = trail.rowStart(bandStart[band]); pixel < last; pixel++)
+			{
+				float sum = depositSums[pixel].load(std::memory_order_relaxed);
+				if (sum != 0)
+				{
+					trail.data[pixel] = std::min(trail.data[pixel] + std::min(sum, 1.0f), 1.0f);
+					depositSums[pixel].store(0, std::memory_order_relaxed);
+				}
+			}
+			return;
+		}
+
+		// only this band's owner touches its pixels, count first so every
+		// pixel gets its deposits added at once, whatever order they're in
+		for (std::vector<std::vector<unsigned int>> &lists : depositLists)
+			for (unsigned int pixel : lists[band])
+				depositCounts[pixel] = std::min(depositCounts[pixel] + 1, maxDepositCount);
+
+		for (std::vector<std::vector<unsigned int>> &lists : depositLists)
+		{
+			for (unsigned int pixel : lists[band])
+			{
+				if (depositCounts[pixel] != 0)
+				{
+					trail.data[pixel] = depositedPixel(trail.data[pixel], depositCounts[pixel]);
+					depositCounts[pixel] = 0;
+				}
+			}
+		}
+	};
+
+	// how much of the memory the workers stream through every step (their
+	// bands of both trails once, their agents read and written) is on the
+	// worker's own NUMA node, in percent, and how many bytes per step cross
+	// between nodes, -1 where the system doesn't say where pages are
+	void placementReport(double &localPercent, double &crossNodeBytes)
+	{
+		numaTopology topology = numaTopology::read();
+		int workers = pool.size();
+
+		std::vector<int> workerNode(workers);
+		pool.run([&](int worker)
+		{
+			workerNode[worker] = topology.nodeOfCpu(currentCpu());
+		});
+
+		double local = 0;
+		double remote = 0;
+		std::vector<int> nodes;
+
+		auto count = [&](int worker, const void *start, size_t bytes, int accesses)
+		{
+			pageNodes(start, bytes, nodes);
+			double pageBytes = nodes.empty() ? 0.0 : (double)bytes / nodes.size() * accesses;
+			for (int node : nodes)
+			{
+				if (node == workerNode[worker])
+					local += pageBytes;
+				else if (node >= 0)
+					remote += pageBytes;
+			}
+		};
+
+		for (int worker = 0; worker < workers; worker++)
+		{
+			for (const trailBuffer &trail : trails)
+			{
+				size_t first = trail.rowStart(bandStart[worker]);
+				count(worker, trail.data + first, (trail.rowStart(bandStart[worker + 1]) - first) * sizeof(float), 1);
+			}
+
+			size_t first = agentRange(worker);
+			count(worker, agents.get() + first, (agentRange(worker + 1) - first) * sizeof(agent), 2);
+		}
+
+		bool known = local + remote > 0;
+		localPercent = known ? 100.0 * local / (local + remote) : -1;
+		crossNodeBytes = known ? remote : -1;
+	};
+
+	float *trail()
+	{
+		return trails[currentTrail].data;
+	};
+
+	// sum of the trail intensity
+	double trailMass() const
+	{
+		const trailBuffer &trail = trails[currentTrail];
+
+		double mass = 0;
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+				mass += trail.pixel(x, y);
+		return mass;
+	};
+
+private:
+	threadPool &pool;
+
+	// first row of every worker's band, and one past the last band
+	std::vector<int> bandStart;
+	std::vector<int> bandOfRow;
+
+	// accumulate: pixels deposited on per worker (agent chunk with work
+	// stealing) and band, and the per pixel
+	// count the band owner sums them into (at most 5, more adds nothing)
+	std::vector<std::vector<std::vector<unsigned int>>> depositLists;
+	std::unique_ptr<unsigned char[]> depositCounts;
+
+	// atomic: deposited strength per pixel
+	std::unique_ptr<std::atomic<float>[]> depositSums;
+
+	// the step's kernels for the preset
+	// ---------------------------------
+	// every kernel is a template over what the preset fixes for the whole
+	// run (trail layout, deposit method, sensor radius, streaming stores),
+	// so none of it is a branch per agent or pixel, selectKernels() picks
+	// the instantiations once per load
+	struct kernelTable {
+		void (cpuSimulation::*moveAgents)(const trailBuffer &trail, unsigned int frameSeed, size_t first, size_t last,
+			std::vector<std::vector<unsigned int>> &lists);
+		void (cpuSimulation::*moveBinnedAgents)(int worker, unsigned char *counts, unsigned int frameSeed, const std::function<void(int, int)> &diffuseBin);
+		void (*diffuse)(const trailBuffer &in, trailBuffer &out, int y0, int y1, const diffuseParameters &parameters);
+		void (*diffuseDeposited)(const trailBuffer &in, const unsigned char *counts, trailBuffer &out, int y0, int y1,
+			const diffuseParameters &parameters, float *ring);
+	};
+	kernelTable kernels = {};
+
+	void selectKernels()
+	{
+		bool tiles = layout == trailLayout::tiles;
+		if (tiles)
+			selectAgentKernels<tileLayout>(std::integer_sequence<int, CPU_SENSOR_SIZES>());
+		else
+			selectAgentKernels<rowLayout>(std::integer_sequence<int, CPU_SENSOR_SIZES>());
+
+		if (tiles && streaming)
+		{
+			kernels.diffuse = diffuseTileBand<true>;
+			kernels.diffuseDeposited = diffuseDepositedTiles<true>;
+		}
+		else if (tiles)
+		{
+			kernels.diffuse = diffuseTileBand<false>;
+			kernels.diffuseDeposited = diffuseDepositedTiles<false>;
+		}
+		else if (streaming)
+		{
+			kernels.diffuse = diffuseRows<true>;
+			kernels.diffuseDeposited = diffuseDepositedRows<true>;
+		}
+		else
+		{
+			kernels.diffuse = diffuseRows<false>;
+			kernels.diffuseDeposited = diffuseDepositedRows<false>;
+		}
+	};
+
+	template <typename layout, int... sizes>
+	void selectAgentKernels(std::integer_sequence<int, sizes...> specialized)
+	{
+		if (deposit == depositMethod::atomic)
+			selectSensorKernels<layout, depositMethod::atomic>(specialized);
+		else
+			selectSensorKernels<layout, depositMethod::accumulate>(specialized);
+	};
+
+	// the kernels built for the preset's sensor radius, if there are any
+	template <typename layout, depositMethod method, int... sizes>
+	void selectSensorKernels(std::integer_sequence<int, sizes...>)
+	{
+		setAgentKernels<layout, method, anySensorSize>();
+		((settings.sensorSize == sizes ? setAgentKernels<layout, method, sizes>() : void()), ...);
+	};
+
+	template <typename layout, depositMethod method, int sensorSize>
+	void setAgentKernels()
+	{
+		kernels.moveAgents = &cpuSimulation::moveAgentRange<layout, method, sensorSize>;
+		kernels.moveBinnedAgents = &cpuSimulation::moveBinnedAgents<layout, sensorSize>;
+		specializedSensing = sensorSize != anySensorSize;
+	};
+
+	// diffuseTiles() without deposits, called like diffuseRows()
+	template <bool streaming>
+	static void diffuseTileBand(const trailBuffer &in, trailBuffer &out, int y0, int y1, const diffuseParameters &parameters)
+	{
+		diffuseTiles<streaming>(in, out, y0, y1, parameters);
+	};
+
+	// agent chunks per worker with work stealing, enough for workers that
+	// finish early to find some left
+	static constexpr int agentChunksPerWorker = 8;
+
+	// fused steps: rows per bin, the first bin of every worker's region (its
+	// band), and where every bin's agents start
+	static constexpr int binRows = 64;
+	std::vector<int> regionStart;
+	std::vector<int> regionOfBin;
+	std::vector<size_t> binStart;
+
+	// spawn index of every agent for its random numbers, and room to sort
+	// agents and indices into their new bins
+	std::unique_ptr<unsigned int[]> agentIds;
+	std::unique_ptr<agent[]> spareAgents;
+	std::unique_ptr<unsigned int[]> spareIds;
+
+	// deposit counts of this step and the last (cleared as it's diffused),
+	// pixels deposited on per worker and region for bins at region edges,
+	// agents arriving per worker and bin, where they go when sorted, and
+	// 3 rows per worker to add deposits to rows in
+	std::unique_ptr<unsigned char[]> fusedCounts[2];
+	std::vector<std::vector<std::vector<unsigned int>>> edgeDeposits;
+	std::vector<std::vector<size_t>> binCounts;
+	std::unique_ptr<trailBuffer[]> diffusionRings;
+
+	diffuseParameters diffusion() const
+	{
+		diffuseParameters parameters;
+		parameters.mix = std::min(std::max(settings.diffuseRate, 0.0f), 1.0f);
+		parameters.keep = 1.0f - parameters.mix;
+		parameters.decay = settings.decayRate;
+		return parameters;
+	};
+
+	// bins diffused right after the agents two bins further were moved, the
+	// ones at the region edges need other workers' deposits first
+	static bool innerBin(int bin, int first, int end)
+	{
+		return bin >= first + 2 && bin <= end - 3;
+	};
+
+	// the fused pass over a worker's region, diffuseBin(worker, bin) diffuses a bin
+	template <typename layout, int sensorSize>
+	void moveBinnedAgents(int worker, unsigned char *counts, unsigned int frameSeed, const std::function<void(int, int)> &diffuseBin)
+	{
+		const trailBuffer &trail = trails[currentTrail];
+		int first = regionStart[worker];
+		int end = regionStart[worker + 1];
+
+		std::vector<std::vector<unsigned int>> &lists = edgeDeposits[worker];
+		for (std::vector<unsigned int> &list : lists)
+			list.clear();
+
+		std::vector<size_t> &arrivals = binCounts[worker];
+		std::fill(arrivals.begin(), arrivals.end(), 0);
+
+		for (int bin = first; bin < end; bin++)
+		{
+			for (size_t i = binStart[bin]; i < binStart[bin + 1]; i++)
+			{
+				agent &current = agents[i];
+				moveAgent<layout, sensorSize>(trail, settings, current, agentHash(agentIds[i] + frameSeed));
+
+				int x = (int)current.x;
+				int y = (int)current.y;
+				size_t pixel = layout::offset(trail, x, y);
+				int target = y / binRows;
+				arrivals[target]++;
+
+				// bins only this worker's agents reach get counted right away
+				if (target > first && target < end - 1)
+					counts[pixel] = std::min(counts[pixel] + 1, maxDepositCount);
+				else
+					lists[regionOfBin[target]].push_back((unsigned int)pixel);
+			}
+
+			if (innerBin(bin - 2, first, end))
+				diffuseBin(worker, bin - 2);
+		}
+	};
+
+	// sorts the agents into the bins they moved to, every worker's agents of
+	// a bin stay together and in order, so the order doesn't depend on timing
+	void sortBinnedAgents()
+	{
+		int workers = pool.size();
+		int bins = (int)binStart.size() - 1;
+
+		// the new bin starts wait until the agents left the old ranges
+		std::vector<size_t> sortedStart(bins + 1, agentCount);
+		size_t offset = 0;
+		for (int bin = 0; bin < bins; bin++)
+		{
+			sortedStart[bin] = offset;
+			for (int worker = 0; worker < workers; worker++)
+			{
+				size_t arrivals = binCounts[worker][bin];
+				binCounts[worker][bin] = offset;
+				offset += arrivals;
+			}
+		}
+
+		pool.run([&](int worker)
+		{
+			std::vector<size_t> &next = binCounts[worker];
+			size_t last = agentRange(worker + 1);
+			for (size_t i = agentRange(worker); i < last; i++)
+			{
+				size_t target = next[(int)agents[i].y / binRows]++;
+				spareAgents[target] = agents[i];
+				spareIds[target] = agentIds[i];
+			}
+		});
+
+		std::swap(agents, spareAgents);
+		std::swap(agentIds, spareIds);
+		binStart.swap(sortedStart);
+	};
+
+	// sorts freshly spawned agents by bin, indices are where they were
+	void binAgents(std::vector<agent> &spawned, std::vector<unsigned int> &indices)
+	{
+		int bins = (int)binStart.size() - 1;
+		std::vector<size_t> next(bins + 1, 0);
+		for (const agent &current : spawned)
+			next[(int)current.y / binRows + 1]++;
+		for (int bin = 0; bin < bins; bin++)
+			next[bin + 1] += next[bin];
+		binStart = next;
+
+		std::vector<agent> sorted(spawned.size());
+		indices.resize(spawned.size());
+		for (size_t i = 0; i < spawned.size(); i++)
+		{
+			size_t target = next[(int)spawned[i].y / binRows]++;
+			sorted[target] = spawned[i];
+			indices[target] = (unsigned int)i;
+		}
+		spawned.swap(sorted);
+
+		agentIds.reset(new unsigned int[agentCount]);
+		spareAgents.reset(new agent[agentCount]);
+		spareIds.reset(new unsigned int[agentCount]);
+	};
+
+	// agents [first, last) of moveAgents(), lists are the band lists their
+	// deposits go to, with the layout, deposit method and sensor radius
+	// known at compile time
+	template <typename layout, depositMethod method, int sensorSize>
+	void moveAgentRange(const trailBuffer &trail, unsigned int frameSeed, size_t first, size_t last,
+		std::vector<std::vector<unsigned int>> &lists)
+	{
+		for (std::vector<unsigned int> &list : lists)
+			list.clear();
+
+		for (size_t i = first; i < last; i++)
+		{
+			agent &current = agents[i];
+			moveAgent<layout, sensorSize>(trail, settings, current, agentHash((unsigned int)i + frameSeed));
+
+			int x = (int)current.x;
+			int y = (int)current.y;
+			size_t pixel = layout::offset(trail, x, y);
+
+			if (method == depositMethod::atomic)
+				atomicAdd(depositSums[pixel], depositStrength);
+			else
+				lists[bandOfRow[y]].push_back((unsigned int)pixel);
+		}
+	};
+
+	// row bands of the workers and the deposit buffers for them
+	void resetDeposits()
+	{
+		int workers = pool.size();
+
+		// tiled and fused bands are whole block rows (bins), some stay empty
+		// on small maps
+		bandStart.resize(workers + 1);
+		regionStart.resize(workers + 1);
+		int blockRows = (height + binRows - 1) / binRows;
+		for (int band = 0; band <= workers; band++)
+		{
+			regionStart[band] = blockRows * band / workers;
+			if (layout == trailLayout::tiles || fused)
+				bandStart[band] = std::min(height, binRows * regionStart[band]);
+			else
+				bandStart[band] = height * band / workers;
+		}
+
+		bandOfRow.resize(height);
+		for (int band = 0; band < workers; band++)
+			for (int y = bandStart[band]; y < bandStart[band + 1]; y++)
+				bandOfRow[y] = band;
+
+		size_t pixels = trails[0].floats;
+
+		// cleared by load() like the trails, lists are filled (and so
+		// allocated) by their own worker
+		int chunks = scheduler == cpuScheduler::stealing ? workers * agentChunksPerWorker : workers;
+		depositLists.assign(chunks, std::vector<std::vector<unsigned int>>(workers));
+		depositCounts.reset();
+		depositSums.reset();
+		for (std::unique_ptr<unsigned char[]> &counts : fusedCounts)
+			counts.reset();
+		diffusionRings.reset();
+
+		if (fused)
+		{
+			// the deposit method doesn't matter, deposits are always counted
+			for (std::unique_ptr<unsigned char[]> &counts : fusedCounts)
+				counts.reset(new unsigned char[pixels]);
+			diffusionRings.reset(new trailBuffer[workers]);
+			if (layout == trailLayout::rows)
+				for (int worker = 0; worker < workers; worker++)
+					diffusionRings[worker].resize(width, 3, trailLayout::rows);
+
+			edgeDeposits.assign(workers, std::vector<std::vector<unsigned int>>(workers));
+			binCounts.assign(workers, std::vector<size_t>(blockRows, 0));
+			binStart.assign(blockRows + 1, 0);
+			regionOfBin.resize(blockRows);
+			for (int region = 0; region < workers; region++)
+				for (int bin = regionStart[region]; bin < regionStart[region + 1]; bin++)
+					regionOfBin[bin] = region;
+		}
+		else if (deposit == depositMethod::atomic)
+		{
+			depositSums.reset(new std::atomic<float>[pixels]);
+		}
+		else
+		{
+			depositCounts.reset(new unsigned char[pixels]);
+		}
+	};
+
+	// first agent of a worker, the workers of a node own consecutive ranges,
+	// with fused steps the agents of the worker's bins
+	size_t agentRange(int worker) const
+	{
+		if (fused)
+			return binStart[regionStart[worker]];
+		return agentCount * worker / pool.size();
+	};
+
+	// pins every worker to its CPU, or lets them all run anywhere
+	void placeWorkers()
+	{
+		std::vector<int> cpus = numaTopology::read().workerCpus(pool.size());
+		pool.run([&](int worker)
+		{
+			pinThread(numa ? cpus[worker] : -1);
+		});
+	};
+};
+
+
+// -----------------------------------------------------------------------------
+// benchmark
+// -----------------------------------------------------------------------------
+
+class cpuBenchmark
+{
+	// times the CPU simulation on several map sizes, thread counts and ways
+	// of depositing
+	// ---------------------------------------------------------------------
+	// no window or GL context is needed, every run starts from the same seed,
+	// memory bandwidth counts every trail pixel read once and written once
+	// per diffusion (what a perfectly cached kernel moves), cache misses are
+	// counted over whole steps where the system has the counters for it
+public:
+	cpuBenchmark(const json &benchmarkSettings, const json &basePreset)
+	{
+		base = basePreset;
+		if (!base.contains("seed"))
+			base["seed"] = 1;
+
+		steps = benchmarkSettings.value("steps", 100);
+		warmup = benchmarkSettings.value("warmup", 5);
+		output = benchmarkSettings.value("output", "sweeps/cpu.csv");
+		threadCounts = benchmarkSettings.value("threads", std::vector<int>{0});
+		maps = benchmarkSettings.value("maps", std::vector<std::vector<int>>{{1920, 1080}, {7680, 4320}});
+		streamingStores = benchmarkSettings.value("streamingStores", std::vector<json>{"auto"});
+		deposits = benchmarkSettings.value("deposits", std::vector<std::string>{"accumulate", "atomic"});
+		spawnMethods = benchmarkSettings.value("spawnMethods", std::vector<std::string>{base["spawnMethod"]});
+		layouts = benchmarkSettings.value("trailLayouts", std::vector<std::string>{"rows", "tiles"});
+		images = benchmarkSettings.value("images", false);
+		placements = benchmarkSettings.value("numaPlacement", std::vector<bool>{true});
+		fusedSteps = benchmarkSettings.value("fusedStep", std::vector<bool>{false});
+		schedulers = benchmarkSettings.value("schedulers", std::vector<std::string>{"phases"});
+	};
+
+	int run()
+	{
+		std::filesystem::path outputPath(output);
+		if (outputPath.has_parent_path())
+			std::filesystem::create_directories(outputPath.parent_path());
+
+		std::ofstream csv(output);
+		if (!csv)
+		{
+			std::cout << "Couldn't write benchmark results into: " << output << std::endl;
+			return -1;
+		}
+		csv << "mapWidth,mapHeight,agentNumber,spawnMethod,threads,trailLayout,deposit,streamingStores,msPerStep,mergeMsPerStep,diffuseMsPerStep,agentMsPerStep,diffuseGBs,l1MissesPerStep,llcMissesPerStep,numaPlacement,numaNodes,localPercent,crossNodeMBPerStep,trailMass,fusedStep,scheduler\n";
+
+		int nodes = numaTopology::read().nodes();
+		std::cout << "Last level cache: " << lastLevelCacheBytes() / (1 << 20) << " MiB, NUMA nodes: " << nodes << std::endl;
+		int run = 0;
+
+		for (const std::vector<int> &map : maps)
+		{
+			if (map.size() != 2)
+			{
+				std::cout << "Benchmark maps are [width, height] pairs." << std::endl;
+				return -1;
+			}
+
+			for (int threads : threadCounts)
+			{
+				threadPool pool(threads);
+				cpuSimulation simulation(pool);
+				cacheCounters counters(pool);
+
+				for (const std::string &spawnMethod : spawnMethods)
+				for (const std::string &layout : layouts)
+				for (const std::string &deposit : deposits)
+				for (const json &stores : streamingStores)
+				for (bool placement : placements)
+				for (bool fusedStep : fusedSteps)
+				for (const std::string &scheduler : schedulers)
+				{
+					// fused steps always count deposits and run in phases, one
+					// run covers every method and scheduler
+					if (fusedStep && (deposit != deposits.front() || scheduler != schedulers.front()))
+						continue;
+
+					json preset = base;
+					preset["mapWidth"] = map[0];
+					preset["mapHeight"] = map[1];
+					preset["spawnMethod"] = spawnMethod;
+					preset["trailLayout"] = layout;
+					preset["deposit"] = deposit;
+					preset["streamingStores"] = stores;
+					preset["numaPlacement"] = placement;
+					preset["fusedStep"] = fusedStep;
+					preset["scheduler"] = scheduler;
+
+					simulation.load(preset);
+
+					simulation.run(warmup);
+					simulation.times = cpuStepTimes();
+					counters.start();
+
+					simulation.run(steps);
+
+					long long l1Misses, lastLevelMisses;
+					counters.stop(l1Misses, lastLevelMisses);
+
+					double localPercent, crossNodeBytes;
+					simulation.placementReport(localPercent, crossNodeBytes);
+
+					const cpuStepTimes &times = simulation.times;
+					double perStep = 1000.0 / std::max(times.steps, 1);
+					double total = times.total;
+					// fused steps diffuse most bins while moving the agents
+					double diffusing = simulation.fused ? times.diffuse + times.agents : times.diffuse;
+					double bandwidth = diffusing > 0 ? 2.0 * simulation.trails[0].bytes() * times.steps / 1e9 / diffusing : 0.0;
+
+					csv << map[0] << "," << map[1] << "," << simulation.agentCount << "," << spawnMethod << ","
+						<< pool.size() << "," << layout << "," << deposit << "," << (simulation.streaming ? 1 : 0) << ","
+						<< total * perStep << "," << times.merge * perStep << "," << times.diffuse * perStep << ","
+						<< times.agents * perStep << "," << bandwidth << ","
+						<< perStepCount(l1Misses, times.steps) << "," << perStepCount(lastLevelMisses, times.steps) << ","
+						<< (placement ? 1 : 0) << "," << nodes << "," << localPercent << "," << (crossNodeBytes < 0 ? -1 : crossNodeBytes / 1e6) << ","
+						<< simulation.trailMass() << "," << (simulation.fused ? 1 : 0) << ","
+						<< (simulation.scheduler == cpuScheduler::stealing ? "stealing" : "phases") << "\n";
+					csv.flush();
+
+					std::cout << map[0] << "x" << map[1] << ", " << spawnMethod << ", " << pool.size() << " threads, "
+						<< layout << ", " << deposit << (simulation.streaming ? ", streaming" : "") << (placement ? ", numa" : "") << (simulation.fused ? ", fused" : "") << (simulation.scheduler == cpuScheduler::stealing ? ", stealing" : "")
+						<< (simulation.specializedSensing ? "" : ", generic sensing") << ": "
+						<< total * perStep << " ms per step (merge " << times.merge * perStep
+						<< ", diffusion " << times.diffuse * perStep << " at " << bandwidth << " GB/s"
+						<< ", agents " << times.agents * perStep << ")";
+					if (l1Misses >= 0 || lastLevelMisses >= 0)
+						std::cout << ", misses per step: L1 " << perStepCount(l1Misses, times.steps) << ", LLC " << perStepCount(lastLevelMisses, times.steps);
+					if (localPercent >= 0)
+						std::cout << ", " << localPercent << "% local, " << crossNodeBytes / 1e6 << " MB cross-node per step";
+					std::cout << std::endl;
+
+					if (images)
+						writeImage(simulation, run);
+					run++;
+				}
+			}
+		}
+
+		std::cout << "Benchmark results written into " << output << std::endl;
+		return 0;
+	};
+
+private:
+	json base;
+	int steps;
+	int warmup;
+	std::string output;
+	std::vector<int> threadCounts;
+	std::vector<std::vector<int>> maps;
+	std::vector<json> streamingStores;
+	std::vector<std::string> deposits;
+	std::vector<std::string> spawnMethods;
+	std::vector<std::string> layouts;
+	bool images;
+	std::vector<bool> placements;
+	std::vector<bool> fusedSteps;
+	std::vector<std::string> schedulers;
+
+	static long long perStepCount(long long count, int steps)
+	{
+		return count < 0 ? -1 : count / std::max(steps, 1);
+	};
+
+	// the final trail of run number run next to the csv, in the preset color
+	void writeImage(const cpuSimulation &simulation, int run)
+	{
+		std::vector<float> intensity;
+		simulation.trails[simulation.currentTrail].read(intensity);
+
+		int width = simulation.width;
+		int height = simulation.height;
+		const simulationSettings &settings = simulation.settings;
+		float color[3] = {settings.color_r, settings.color_g, settings.color_b};
+
+		// the trail's bottom row is the image's top one
+		std::vector<unsigned char> rgb((size_t)width * height * 3);
+		for (int y = 0; y < height; y++)
+			for (int x = 0; x < width; x++)
+				for (int channel = 0; channel < 3; channel++)
+					rgb[((size_t)(height - 1 - y) * width + x) * 3 + channel] = (unsigned char)(std::min(1.0f, color[channel] * intensity[(size_t)y * width + x]) * 255.0f + 0.5f);
+
+		char name[32];
+		snprintf(name, sizeof(name), "_%04d.ppm", run);
+
+		std::filesystem::path path(output);
+		path.replace_extension();
+		writePPM(path.string() + name, width, height, rgb);
+	};
+};
+#endif
@@ -0,0 +1,92 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+
+class displayTarget
+{
+	// offscreen image the map is drawn into at render resolution
+	// ----------------------------------------------------------
+	// the display shader draws width x height pixels no matter how big the
+	// window is, present() then scales the image into the window keeping its
+	// aspect ratio (black bars on the sides), so resizing the window or going
+	// fullscreen never touches the simulation and captures keep their size
+public:
+	int width = 0;
+	int height = 0;
+	unsigned int framebuffer = 0;
+	unsigned int colorTexture = 0;
+
+	displayTarget() {};
+
+	~displayTarget()
+	{
+		if (framebuffer != 0)
+		{
+			glDeleteFramebuffers(1, &framebuffer);
+			glDeleteTextures(1, &colorTexture);
+		}
+	};
+
+	displayTarget(const displayTarget&) = delete;
+	displayTarget& operator=(const displayTarget&) = delete;
+
+	void resize(int newWidth, int newHeight)
+	{
+		if (newWidth == width && newHeight == height)
+			return;
+
+		width = newWidth;
+		height = newHeight;
+
+		if (framebuffer == 0)
+		{
+			glGenFramebuffers(1, &framebuffer);
+			glGenTextures(1, &colorTexture);
+		}
+
+		glBindTexture(GL_TEXTURE_2D, colorTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+
+		float black[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+		glClearBufferfv(GL_COLOR, 0, black);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	};
+
+	// draw (and capture) calls after this go into the offscreen image
+	void bind()
+	{
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+		glViewport(0, 0, width, height);
+	};
+
+	// scales the image into the window's framebuffer, letterboxed
+	void present(int windowWidth, int windowHeight)
+	{
+		double scale = std::min((double)windowWidth / width, (double)windowHeight / height);
+		int scaledWidth = (int)(width * scale);
+		int scaledHeight = (int)(height * scale);
+		int x = (windowWidth - scaledWidth) / 2;
+		int y = (windowHeight - scaledHeight) / 2;
+
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		glViewport(0, 0, windowWidth, windowHeight);
+
+		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+
+		glBlitFramebuffer(0, 0, width, height, x, y, x + scaledWidth, y + scaledHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	};
+};
+#endif
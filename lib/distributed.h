@@ -0,0 +1,735 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+
+#ifdef __linux__
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#endif
+
+#include "json.hpp"
+using json = nlohmann::json;
+
+#include "shader.h"
+#include "simulation.h"
+#include "tiled.h"
+
+
+#ifdef __linux__
+
+// one length prefixed message going out and one coming in on a socket
+struct socketTransfer {
+	int socket;
+	const std::vector<char> *outgoing;
+	std::vector<char> *incoming;
+
+	uint64_t outLength = 0;
+	uint64_t inLength = 0;
+	size_t sent = 0;
+	size_t received = 0;
+};
+
+// sends every transfer's outgoing message while receiving the other ends'
+// messages, so processes exchanging big messages with each other never all
+// block on full socket buffers, false if a peer went away
+inline bool exchangeMessages(std::vector<socketTransfer> &transfers)
+{
+	const size_t header = sizeof(uint64_t);
+
+	for (socketTransfer &transfer : transfers)
+	{
+		transfer.outLength = transfer.outgoing->size();
+		transfer.inLength = 0;
+		transfer.sent = 0;
+		transfer.received = 0;
+	}
+
+	while (true)
+	{
+		std::vector<pollfd> polls;
+		std::vector<socketTransfer*> polled;
+
+		for (socketTransfer &transfer : transfers)
+		{
+			bool sending = transfer.sent < header + transfer.outLength;
+			bool receiving = transfer.received < header || transfer.received < header + transfer.inLength;
+			if (!sending && !receiving)
+				continue;
+
+			pollfd entry = {transfer.socket, 0, 0};
+			entry.events = (sending ? POLLOUT : 0) | (receiving ? POLLIN : 0);
+			polls.push_back(entry);
+			polled.push_back(&transfer);
+		}
+
+		if (polls.empty())
+			return true;
+
+		if (poll(polls.data(), polls.size(), -1) < 0)
+			return false;
+
+		for (size_t i = 0; i < polls.size(); i++)
+		{
+			socketTransfer &transfer = *polled[i];
+
+			if (polls[i].revents & POLLOUT)
+			{
+				// the length header first, then the message
+				ssize_t written;
+				if (transfer.sent < header)
+					written = send(transfer.socket, (char*)&transfer.outLength + transfer.sent, header - transfer.sent, MSG_NOSIGNAL);
+				else
+					written = send(transfer.socket, transfer.outgoing->data() + transfer.sent - header, header + transfer.outLength - transfer.sent, MSG_NOSIGNAL);
+
+				if (written < 0)
+					return false;
+				transfer.sent += written;
+			}
+
+			if (polls[i].revents & POLLIN)
+			{
+				ssize_t read;
+				if (transfer.received < header)
+				{
+					read = recv(transfer.socket, (char*)&transfer.inLength + transfer.received, header - transfer.received, 0);
+					if (read > 0 && transfer.received + read == header)
+						transfer.incoming->resize(transfer.inLength);
+				}
+				else
+				{
+					read = recv(transfer.socket, transfer.incoming->data() + transfer.received - header, header + transfer.inLength - transfer.received, 0);
+				}
+
+				if (read <= 0)
+					return false;
+				transfer.received += read;
+			}
+			else if (polls[i].revents & (POLLERR | POLLHUP))
+			{
+				return false;
+			}
+		}
+	}
+}
+
+// blocking write / read of a whole block on a socket
+inline bool writeAll(int socket, const void *data, size_t size)
+{
+	const char *bytes = (const char*) data;
+	while (size > 0)
+	{
+		ssize_t written = send(socket, bytes, size, MSG_NOSIGNAL);
+		if (written <= 0)
+			return false;
+		bytes += written;
+		size -= written;
+	}
+	return true;
+}
+
+inline bool readAll(int socket, void *data, size_t size)
+{
+	char *bytes = (char*) data;
+	while (size > 0)
+	{
+		ssize_t read = recv(socket, bytes, size, 0);
+		if (read <= 0)
+			return false;
+		bytes += read;
+		size -= read;
+	}
+	return true;
+}
+
+
+// what a worker reports after every step and at the end of a run
+struct workerStepReport {
+	double exchangeMilliseconds;
+	uint32_t migrants;
+	uint32_t agents;
+};
+
+struct workerFinalReport {
+	uint64_t agents;
+	uint64_t migrated;
+	uint64_t dropped;
+	double trailMass;
+};
+
+
+class stripeWorker
+{
+	// one process of a distributed run, simulates a horizontal stripe of the map
+	// --------------------------------------------------------------------------
+	// the stripe is a region of a tiled simulation, every step its edge rows
+	// are traded with the processes above and below (trail rows as deep as
+	// the halo, one row of deposit counts) and agents that left the stripe
+	// are sent to the neighbour they walked into, the coordinator starts
+	// every step and waits for all workers to finish it
+public:
+	stripeWorker(const json &preset, int rank, int processes, int controlSocket, int upSocket, int downSocket)
+	{
+		this->preset = preset;
+		this->controlSocket = controlSocket;
+		this->upSocket = upSocket;
+		this->downSocket = downSocket;
+
+		int mapHeight = preset["mapHeight"];
+		stripeStart = (long long)mapHeight * rank / processes;
+		stripeEnd = (long long)mapHeight * (rank + 1) / processes;
+		agentShare = (unsigned int)preset["agentNumber"] / processes;
+	};
+
+	// runs steps until the coordinator says to stop, returns the exit code
+	int run()
+	{
+		if (!glfwInit())
+			return fail("Failed to initialize glfw");
+
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+		GLFWwindow *window = glfwCreateWindow(1, 1, "Slime sim worker", NULL, NULL);
+		if (window == NULL)
+			return fail("Failed to create GLFW window");
+		glfwMakeContextCurrent(window);
+
+		if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+			return fail("Failed to initialize GLAD");
+
+		int result = simulate();
+
+		glfwTerminate();
+		return result;
+	};
+
+private:
+	json preset;
+	int controlSocket, upSocket, downSocket;
+	int stripeStart, stripeEnd;
+	unsigned int agentShare;
+
+	tiledSimulation sim;
+	unsigned int migrationSSBO = 0;
+	unsigned int freeSlotSSBO = 0;
+	unsigned int arrivalSSBO = 0;
+	size_t arrivalCapacity = 0;
+
+	// empty slots listed in the free slot buffer
+	unsigned int freeSlots = 0;
+
+	uint64_t migrated = 0;
+	uint64_t dropped = 0;
+	double exchangeMilliseconds = 0;
+
+	int fail(const std::string &message)
+	{
+		std::cout << message << std::endl;
+		return -1;
+	};
+
+	int simulate()
+	{
+		computeShader diffuseShader("shaders/diffuse.comp", {"TILED"});
+		computeShader agentShader("shaders/slimeFinal.comp", {"TILED", "DISTRIBUTED"});
+		computeShader migrateShader("shaders/migrate.comp", {"TILED"});
+		if (!diffuseShader.valid || !agentShader.valid || !migrateShader.valid)
+			return fail("Worker shaders failed to build");
+
+		// room for arrivals, agents spread unevenly over the stripes over time
+		mapRegion stripe = {0, stripeStart, (int)preset["mapWidth"], stripeEnd - stripeStart};
+		if (!sim.load(preset, stripe, agentShare + 4096))
+			return -1;
+
+		if (stripe.height < sim.halo)
+			return fail("Stripes have to be at least as tall as the halo, use fewer processes");
+
+		// outbox header (outCount, freeCount) + room for every agent to leave
+		glGenBuffers(1, &migrationSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, migrationSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, 2 * sizeof(unsigned int) + sim.agentCapacity * sizeof(agent), NULL, GL_DYNAMIC_READ);
+		unsigned int counters[2] = {0, 0};
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), counters);
+
+		glGenBuffers(1, &freeSlotSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, freeSlotSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(1u, sim.agentCapacity) * sizeof(unsigned int), NULL, GL_DYNAMIC_DRAW);
+
+		glGenBuffers(1, &arrivalSSBO);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		while (true)
+		{
+			char command;
+			if (!readAll(controlSocket, &command, 1) || command == 'Q')
+				break;
+
+			double stepExchange = exchangeMilliseconds;
+
+			uint32_t migrants;
+			if (!step(diffuseShader, agentShader, migrateShader, migrants))
+				return fail("Lost connection to a neighbouring worker");
+
+			glFinish();
+			stepExchange = exchangeMilliseconds - stepExchange;
+
+			workerStepReport report = {stepExchange, migrants, sim.agentNumber - freeSlots};
+			if (!writeAll(controlSocket, &report, sizeof(report)))
+				break;
+		}
+
+		workerFinalReport report = {sim.agentNumber - freeSlots, migrated, dropped, trailMass()};
+		writeAll(controlSocket, &report, sizeof(report));
+		return 0;
+	};
+
+	bool step(computeShader &diffuseShader, computeShader &agentShader, computeShader &migrateShader, uint32_t &migrants)
+	{
+		sim.diffuse(diffuseShader);
+
+		// agents near the stripe edges sense the neighbours' trail
+		if (!exchangeRows(sim.trailTextures[sim.currentTrail], sim.halo))
+			return false;
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, migrationSSBO);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, freeSlotSSBO);
+		sim.moveAgents(agentShader);
+
+		if (!migrateAgents(migrateShader, migrants))
+			return false;
+
+		sim.shareDeposits();
+
+		// the next blur reads one row of deposits past the stripe edges
+		return exchangeRows(sim.depositTexture, 1);
+	};
+
+	// trades the first and last rows of the stripe for the neighbours' rows next to it
+	bool exchangeRows(unsigned int texture, int rows)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		std::vector<char> toUp, toDown, fromUp, fromDown;
+		std::vector<socketTransfer> transfers;
+
+		if (upSocket >= 0)
+		{
+			sim.readRows(texture, stripeStart, rows, toUp);
+			transfers.push_back({upSocket, &toUp, &fromUp});
+		}
+		if (downSocket >= 0)
+		{
+			sim.readRows(texture, stripeEnd - rows, rows, toDown);
+			transfers.push_back({downSocket, &toDown, &fromDown});
+		}
+
+		if (!exchangeMessages(transfers))
+			return false;
+
+		if (upSocket >= 0)
+			sim.writeRows(texture, stripeStart - rows, rows, fromUp);
+		if (downSocket >= 0)
+			sim.writeRows(texture, stripeEnd, rows, fromDown);
+
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+		exchangeMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return true;
+	};
+
+	// sends the agents that left the stripe to the neighbour they walked
+	// into and puts the ones arriving from the neighbours into the buffer
+	bool migrateAgents(computeShader &migrateShader, uint32_t &migrants)
+	{
+		unsigned int counters[2];
+		glGetNamedBufferSubData(migrationSSBO, 0, sizeof(counters), counters);
+		unsigned int leaving = counters[0];
+		freeSlots = counters[1];
+
+		std::vector<agent> outbox(leaving);
+		if (leaving > 0)
+			glGetNamedBufferSubData(migrationSSBO, sizeof(counters), leaving * sizeof(agent), outbox.data());
+
+		std::vector<char> toUp, toDown, fromUp, fromDown;
+		for (const agent &a : outbox)
+		{
+			std::vector<char> &target = a.y < stripeStart ? toUp : toDown;
+			target.insert(target.end(), (const char*)&a, (const char*)&a + sizeof(agent));
+		}
+
+		auto start = std::chrono::steady_clock::now();
+
+		std::vector<socketTransfer> transfers;
+		if (upSocket >= 0)
+			transfers.push_back({upSocket, &toUp, &fromUp});
+		if (downSocket >= 0)
+			transfers.push_back({downSocket, &toDown, &fromDown});
+
+		if (!exchangeMessages(transfers))
+			return false;
+
+		exchangeMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		std::vector<char> arrivals = fromUp;
+		arrivals.insert(arrivals.end(), fromDown.begin(), fromDown.end());
+		unsigned int arriving = arrivals.size() / sizeof(agent);
+
+		migrants = leaving;
+		migrated += leaving;
+
+		if (arriving > 0)
+		{
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, arrivalSSBO);
+			if (arrivals.size() > arrivalCapacity)
+			{
+				glBufferData(GL_SHADER_STORAGE_BUFFER, arrivals.size(), arrivals.data(), GL_STREAM_DRAW);
+				arrivalCapacity = arrivals.size();
+			}
+			else
+			{
+				glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, arrivals.size(), arrivals.data());
+			}
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+			migrateShader.use();
+			migrateShader.setInt("tileSize", sim.tileSize);
+			migrateShader.setInt("tileHalo", sim.halo);
+			migrateShader.setIvec2("tileCount", sim.tilesX, sim.tilesY);
+			migrateShader.setIvec2("regionOrigin", sim.region.x, sim.region.y);
+			migrateShader.setIvec2("regionEnd", sim.region.x + sim.region.width, sim.region.y + sim.region.height);
+			migrateShader.setUint("freeSlotCount", freeSlots);
+			migrateShader.setUint("usedSlots", sim.agentNumber);
+
+			glBindImageTexture(2, sim.depositTexture, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, sim.settingsSSBO);
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 4, sim.agentDataSSBO, 0, sim.agentCapacity * sizeof(agent));
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, freeSlotSSBO);
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 9, arrivalSSBO, 0, arrivals.size());
+
+			migrateShader.dispatch((arriving + 63) / 64, 1);
+			glMemoryBarrier(GL_ALL_BARRIER_BITS);
+
+			// arrivals take the last listed free slots, then go after the used ones
+			unsigned int reused = std::min(arriving, freeSlots);
+			unsigned int appended = arriving - reused;
+			unsigned int room = sim.agentCapacity - sim.agentNumber;
+
+			freeSlots -= reused;
+			sim.agentNumber += std::min(appended, room);
+			dropped += appended - std::min(appended, room);
+		}
+
+		counters[0] = 0;
+		counters[1] = freeSlots;
+		glNamedBufferSubData(migrationSSBO, 0, sizeof(counters), counters);
+		return true;
+	};
+
+	// total trail intensity of the stripe
+	double trailMass()
+	{
+		double mass = 0;
+		std::vector<float> tile;
+		int side = sim.tileSize + 2 * sim.halo;
+
+		for (int tileY = 0; tileY < sim.tilesY; tileY++)
+		{
+			for (int tileX = 0; tileX < sim.tilesX; tileX++)
+			{
+				sim.readTile(tileX, tileY, tile);
+
+				int columns = std::min(sim.tileSize, sim.region.width - tileX * sim.tileSize);
+				int rows = std::min(sim.tileSize, sim.region.height - tileY * sim.tileSize);
+				for (int y = 0; y < rows; y++)
+					for (int x = 0; x < columns; x++)
+						mass += tile[(size_t)(y + sim.halo) * side + x + sim.halo];
+			}
+		}
+
+		return mass;
+	};
+};
+
+#endif
+
+
+class scalingStudy
+{
+	// runs a preset split into horizontal stripes over N processes
+	// ------------------------------------------------------------
+	// every process has its own GL context and simulates one stripe, the
+	// processes talk over unix domain sockets, this process only coordinates
+	// the steps and collects timings, on one machine it stands in for a cluster
+	// strong scaling splits the same map over more processes, weak scaling
+	// grows the map (and agents) with the process count so every stripe keeps
+	// the same size
+public:
+	scalingStudy(const json &studySettings, const json &basePreset)
+	{
+		base = basePreset;
+		steps = studySettings.value("steps", 200);
+		warmup = studySettings.value("warmup", 10);
+		output = studySettings.value("output", "sweeps/scaling.csv");
+		processCounts = studySettings.value("processes", std::vector<int>{1, 2, 4});
+		modes = studySettings.value("scaling", std::vector<std::string>{"strong", "weak"});
+	};
+
+	int run()
+	{
+		#ifndef __linux__
+		std::cout << "Distributed runs need linux (fork and unix domain sockets)." << std::endl;
+		return -1;
+		#else
+		if (base["simulationShader"] != "stageFinal")
+		{
+			std::cout << "Distributed runs only work with the stageFinal simulation shader." << std::endl;
+			return -1;
+		}
+
+		std::filesystem::path outputPath(output);
+		if (outputPath.has_parent_path())
+			std::filesystem::create_directories(outputPath.parent_path());
+
+		std::ofstream csv(output);
+		if (!csv)
+		{
+			std::cout << "Couldn't write scaling results into: " << output << std::endl;
+			return -1;
+		}
+		csv << "scaling,processes,mapWidth,mapHeight,agentNumber,steps,msPerStep,exchangeMsPerStep,computeMsPerStep,migrantsPerStep,speedup,efficiency,agentsAfter,dropped,trailMass\n";
+
+		for (const std::string &mode : modes)
+		{
+			double baseMilliseconds = 0;
+			int baseProcesses = 0;
+
+			for (int processes : processCounts)
+			{
+				json preset = base;
+				if (mode == "weak")
+				{
+					preset["mapHeight"] = (int)base["mapHeight"] * processes;
+					preset["agentNumber"] = (unsigned int)base["agentNumber"] * processes;
+				}
+
+				runResult result;
+				if (!runProcesses(preset, processes, result))
+					return -1;
+
+				// relative to the first process count of the list
+				if (baseProcesses == 0)
+				{
+					baseMilliseconds = result.msPerStep;
+					baseProcesses = processes;
+				}
+
+				double speedup, efficiency;
+				if (mode == "weak")
+				{
+					speedup = baseMilliseconds / result.msPerStep * processes / baseProcesses;
+					efficiency = baseMilliseconds / result.msPerStep;
+				}
+				else
+				{
+					speedup = baseMilliseconds / result.msPerStep;
+					efficiency = speedup * baseProcesses / processes;
+				}
+
+				csv << mode << "," << processes << "," << preset["mapWidth"] << "," << preset["mapHeight"] << "," << preset["agentNumber"]
+					<< "," << steps << "," << result.msPerStep << "," << result.exchangeMsPerStep << "," << result.computeMsPerStep
+					<< "," << result.migrantsPerStep << "," << speedup << "," << efficiency
+					<< "," << result.agents << "," << result.dropped << "," << result.trailMass << "\n";
+				csv.flush();
+
+				std::cout << mode << " scaling, " << processes << " processes: " << result.msPerStep << " ms/step ("
+					<< result.exchangeMsPerStep << " exchanging), speedup " << speedup << ", efficiency " << efficiency << std::endl;
+			}
+		}
+
+		return 0;
+		#endif
+	};
+
+private:
+	json base;
+	int steps;
+	int warmup;
+	std::string output;
+	std::vector<int> processCounts;
+	std::vector<std::string> modes;
+
+	struct runResult {
+		double msPerStep = 0;
+		double exchangeMsPerStep = 0;
+		double computeMsPerStep = 0;
+		double migrantsPerStep = 0;
+		uint64_t agents = 0;
+		uint64_t dropped = 0;
+		double trailMass = 0;
+	};
+
+	#ifdef __linux__
+	// forks one worker per stripe, steps them warmup + steps times and
+	// collects their reports, stepping is timed from the coordinator
+	bool runProcesses(const json &preset, int processes, runResult &result)
+	{
+		std::vector<int> control(processes * 2, -1);
+		std::vector<int> links(std::max(0, processes - 1) * 2, -1);
+
+		// closes every socket made so far, for runs that can't start
+		auto closeSockets = [&]()
+		{
+			for (int fd : control)
+				if (fd >= 0)
+					close(fd);
+			for (int fd : links)
+				if (fd >= 0)
+					close(fd);
+		};
+
+		bool socketsMade = true;
+		for (int i = 0; i < processes && socketsMade; i++)
+			socketsMade = socketpair(AF_UNIX, SOCK_STREAM, 0, &control[i * 2]) == 0;
+		for (int i = 0; i + 1 < processes && socketsMade; i++)
+			socketsMade = socketpair(AF_UNIX, SOCK_STREAM, 0, &links[i * 2]) == 0;
+
+		if (!socketsMade)
+		{
+			std::cout << "Couldn't create the sockets of the " << processes << " process run: " << std::strerror(errno) << std::endl;
+			closeSockets();
+			return false;
+		}
+
+		std::vector<pid_t> workers;
+		for (int rank = 0; rank < processes; rank++)
+		{
+			pid_t pid = fork();
+			if (pid < 0)
+			{
+				// stop the workers that did start, closing their sockets ends their runs too
+				std::cout << "Couldn't start worker " << rank << " of the " << processes << " process run: " << std::strerror(errno) << std::endl;
+				closeSockets();
+				for (pid_t worker : workers)
+				{
+					kill(worker, SIGTERM);
+					waitpid(worker, NULL, 0);
+				}
+				return false;
+			}
+			if (pid == 0)
+			{
+				// keep only this worker's ends of the sockets
+				int controlSocket = control[rank * 2 + 1];
+				int upSocket = rank > 0 ? links[(rank - 1) * 2 + 1] : -1;
+				int downSocket = rank + 1 < processes ? links[rank * 2] : -1;
+
+				for (int fd : control)
+					if (fd != controlSocket)
+						close(fd);
+				for (int fd : links)
+					if (fd != upSocket && fd != downSocket)
+						close(fd);
+
+				stripeWorker worker(preset, rank, processes, controlSocket, upSocket, downSocket);
+				int code = worker.run();
+				std::cout.flush();
+				_exit(code == 0 ? 0 : 1);
+			}
+			workers.push_back(pid);
+		}
+
+		for (int i = 0; i < processes; i++)
+			close(control[i * 2 + 1]);
+		for (int fd : links)
+			close(fd);
+
+		bool ok = true;
+		double milliseconds = 0, exchange = 0;
+		uint64_t migrants = 0;
+
+		for (int i = 0; i < warmup + steps && ok; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+
+			char command = 'S';
+			for (int rank = 0; rank < processes; rank++)
+				ok = ok && writeAll(control[rank * 2], &command, 1);
+
+			// the step is done once every worker finished it
+			double slowestExchange = 0;
+			uint32_t stepMigrants = 0;
+			for (int rank = 0; rank < processes && ok; rank++)
+			{
+				workerStepReport report = {};
+				ok = readAll(control[rank * 2], &report, sizeof(report));
+				slowestExchange = std::max(slowestExchange, report.exchangeMilliseconds);
+				stepMigrants += report.migrants;
+			}
+
+			if (i >= warmup)
+			{
+				milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+				exchange += slowestExchange;
+				migrants += stepMigrants;
+			}
+		}
+
+		char command = 'Q';
+		for (int rank = 0; rank < processes; rank++)
+		{
+			if (ok && writeAll(control[rank * 2], &command, 1))
+			{
+				workerFinalReport report;
+				if (readAll(control[rank * 2], &report, sizeof(report)))
+				{
+					result.agents += report.agents;
+					result.dropped += report.dropped;
+					result.trailMass += report.trailMass;
+					continue;
+				}
+			}
+			ok = false;
+		}
+
+		for (int rank = 0; rank < processes; rank++)
+		{
+			close(control[rank * 2]);
+			if (!ok && workers[rank] > 0)
+				kill(workers[rank], SIGTERM);
+			waitpid(workers[rank], NULL, 0);
+		}
+
+		if (!ok)
+		{
+			std::cout << "A worker of the " << processes << " process run failed." << std::endl;
+			return false;
+		}
+
+		int timedSteps = std::max(1, steps);
+		result.msPerStep = milliseconds / timedSteps;
+		result.exchangeMsPerStep = exchange / timedSteps;
+		result.computeMsPerStep = result.msPerStep - result.exchangeMsPerStep;
+		result.migrantsPerStep = (double)migrants / timedSteps;
+		return true;
+	};
+	#endif
+};
+#endif
@@ -0,0 +1,205 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <condition_variable>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <limits.h>
+#endif
+
+class fileWatcher
+{
+	// reports files in the watched directories that were written since the last call
+	// ------------------------------------------------------------------------------
+	// a small thread waits for changes and collects them, on linux it blocks
+	// on inotify, anywhere else it compares modification times 4 times a
+	// second, changed() is called from that thread whenever files changed,
+	// e.g. to wake a main loop that blocks until something happens
+public:
+	fileWatcher(const std::vector<std::string> &directories, std::function<void()> changed = nullptr)
+	{
+		this->directories = directories;
+		this->changed = std::move(changed);
+
+		#ifdef __linux__
+		inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		for (const std::string &directory : directories)
+		{
+			// editors often save by writing a new file and renaming it over the old one
+			int watch = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+			watchedDirectories[watch] = directory;
+		}
+
+		// the destructor writes into it to end the thread's poll()
+		if (inotifyFd >= 0 && pipe(stopPipe) == 0)
+			watcher = std::thread(&fileWatcher::watchLoop, this);
+		#else
+		modifiedTimes = scanDirectories();
+		watcher = std::thread(&fileWatcher::watchLoop, this);
+		#endif
+	};
+
+	~fileWatcher()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		stop.notify_one();
+
+		#ifdef __linux__
+		if (stopPipe[1] >= 0)
+		{
+			char byte = 0;
+			ssize_t written = write(stopPipe[1], &byte, 1);
+			(void)written;
+		}
+		#endif
+
+		if (watcher.joinable())
+			watcher.join();
+
+		#ifdef __linux__
+		if (inotifyFd >= 0)
+			close(inotifyFd);
+		for (int fd : stopPipe)
+			if (fd >= 0)
+				close(fd);
+		#endif
+	};
+
+	fileWatcher(const fileWatcher&) = delete;
+	fileWatcher& operator=(const fileWatcher&) = delete;
+
+	// paths (directory/name) of files changed since the last call, never blocks
+	std::vector<std::string> changedFiles()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<std::string> files;
+		std::swap(files, pending);
+		return files;
+	};
+
+private:
+	std::vector<std::string> directories;
+	std::function<void()> changed;
+
+	std::thread watcher;
+	std::mutex mutex;
+	std::condition_variable stop;
+	bool stopping = false;
+
+	// changed files nobody asked for yet
+	std::vector<std::string> pending;
+
+	// adds paths to pending and reports them, returns once stopping
+	void watchLoop()
+	{
+		while (true)
+		{
+			std::vector<std::string> paths = waitForChanges();
+			if (paths.empty())
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (stopping)
+					return;
+				continue;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				for (const std::string &path : paths)
+					if (std::find(pending.begin(), pending.end(), path) == pending.end())
+						pending.push_back(path);
+			}
+
+			if (changed)
+				changed();
+		}
+	};
+
+	#ifdef __linux__
+	int inotifyFd = -1;
+	int stopPipe[2] = {-1, -1};
+	std::map<int, std::string> watchedDirectories;
+
+	// blocks until inotify has events or the watcher stops
+	std::vector<std::string> waitForChanges()
+	{
+		std::vector<std::string> paths;
+
+		pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {stopPipe[0], POLLIN, 0}};
+		if (poll(fds, 2, -1) <= 0 || (fds[1].revents & POLLIN))
+			return paths;
+
+		alignas(inotify_event) char buffer[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+		ssize_t length;
+		while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+		{
+			for (char *ptr = buffer; ptr < buffer + length; ptr += sizeof(inotify_event) + ((inotify_event*)ptr)->len)
+			{
+				inotify_event *event = (inotify_event*) ptr;
+				if (event->len == 0)
+					continue;
+
+				std::string path = watchedDirectories[event->wd] + "/" + event->name;
+				if (std::find(paths.begin(), paths.end(), path) == paths.end())
+					paths.push_back(path);
+			}
+		}
+		return paths;
+	};
+	#else
+	std::map<std::string, std::filesystem::file_time_type> modifiedTimes;
+
+	// scans the directories every 250 ms until a file changed or the watcher stops
+	std::vector<std::string> waitForChanges()
+	{
+		std::vector<std::string> paths;
+		while (paths.empty())
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				if (stop.wait_for(lock, std::chrono::milliseconds(250), [this]() { return stopping; }))
+					return paths;
+			}
+
+			std::map<std::string, std::filesystem::file_time_type> times = scanDirectories();
+			for (const auto &file : times)
+			{
+				auto previous = modifiedTimes.find(file.first);
+				if (previous == modifiedTimes.end() || previous->second != file.second)
+					paths.push_back(file.first);
+			}
+			modifiedTimes = times;
+		}
+		return paths;
+	};
+
+	std::map<std::string, std::filesystem::file_time_type> scanDirectories()
+	{
+		std::map<std::string, std::filesystem::file_time_type> times;
+		std::error_code error;
+
+		for (const std::string &directory : directories)
+			for (const auto &entry : std::filesystem::directory_iterator(directory, error))
+				if (entry.is_regular_file(error))
+					times[directory + "/" + entry.path().filename().string()] = entry.last_write_time(error);
+
+		return times;
+	};
+	#endif
+};
+#endif
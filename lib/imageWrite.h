@@ -0,0 +1,55 @@
+#ifndef IMAGE_WRITE_H
+#define IMAGE_WRITE_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+
+// writes 8 bit rgb pixels (top row first) into a binary .ppm file
+inline bool writePPM(const std::string &path, int width, int height, const std::vector<unsigned char> &rgb)
+{
+	FILE *file = fopen(path.c_str(), "wb");
+	if (file == NULL)
+		return false;
+
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	fwrite(rgb.data(), 1, (size_t)width * height * 3, file);
+	fclose(file);
+
+	return true;
+}
+
+// box filters an rgba float image (bottom row first, like opengl returns it)
+// down to thumbWidth pixels wide, keeping the aspect ratio
+inline void makeThumbnail(const std::vector<float> &rgba, int width, int height, int thumbWidth,
+	std::vector<unsigned char> &rgb, int &thumbHeight)
+{
+	thumbWidth = std::max(1, std::min(thumbWidth, width));
+	thumbHeight = std::max(1, height * thumbWidth / width);
+	rgb.assign((size_t)thumbWidth * thumbHeight * 3, 0);
+
+	for (int ty = 0; ty < thumbHeight; ty++)
+	{
+		int y0 = ty * height / thumbHeight;
+		int y1 = std::max(y0 + 1, (ty + 1) * height / thumbHeight);
+
+		for (int tx = 0; tx < thumbWidth; tx++)
+		{
+			int x0 = tx * width / thumbWidth;
+			int x1 = std::max(x0 + 1, (tx + 1) * width / thumbWidth);
+
+			float sum[3] = {0, 0, 0};
+			for (int y = y0; y < y1; y++)
+				for (int x = x0; x < x1; x++)
+					for (int c = 0; c < 3; c++)
+						sum[c] += rgba[((size_t)y * width + x) * 4 + c];
+
+			float area = (float)(x1 - x0) * (y1 - y0);
+			size_t out = ((size_t)(thumbHeight - 1 - ty) * thumbWidth + tx) * 3;
+			for (int c = 0; c < 3; c++)
+				rgb[out + c] = (unsigned char)(std::min(1.0f, std::max(0.0f, sum[c] / area)) * 255.0f + 0.5f);
+		}
+	}
+}
+#endif
@@ -0,0 +1,159 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+// has to match metricsBuffer in shaders/metrics.glsl
+const int metricDensityCells = 8;
+const int metricHeadingBins = 16;
+
+struct metricsBlock {
+	float mass;
+	unsigned int covered;
+	unsigned int agents;
+	unsigned int resets;
+	unsigned int density[metricDensityCells * metricDensityCells];
+	unsigned int headings[metricHeadingBins];
+};
+
+class stepMetrics
+{
+	// per step statistics of a single map, logged to a csv every few steps
+	// --------------------------------------------------------------------
+	// the reduction passes (shaders/metrics.comp) leave a few hundred bytes
+	// in the metrics buffer, queue() copies them into a ring of readback
+	// buffers that are only read once their fence signaled, so logging
+	// never waits for the GPU and the trail never leaves it
+	// one row per logged step: trail mass and covered share like a sweep's
+	// metrics.csv, agents, edge resets since the row before, agents in every
+	// region of an 8x8 grid (row by row from y = 0) and in 16 heading bins
+	// (counter-clockwise from +x)
+public:
+	bool enabled = false;
+
+	stepMetrics() {};
+
+	stepMetrics(const std::string &outputPath, int every, int ringSize)
+	{
+		this->every = std::max(1, every);
+
+		csv.open(outputPath);
+		if (!csv)
+		{
+			std::cout << "Couldn't write metrics into: " << outputPath << std::endl;
+			return;
+		}
+
+		csv << "step,trailMass,coverage,agents,resets";
+		for (int cell = 0; cell < metricDensityCells * metricDensityCells; cell++)
+			csv << ",density" << cell;
+		for (int bin = 0; bin < metricHeadingBins; bin++)
+			csv << ",heading" << bin;
+		csv << "\n";
+
+		slots.resize(std::max(2, ringSize));
+		for (readbackSlot &slot : slots)
+		{
+			glCreateBuffers(1, &slot.buffer);
+			glNamedBufferData(slot.buffer, sizeof(metricsBlock), NULL, GL_STREAM_READ);
+		}
+
+		enabled = true;
+	};
+
+	// true after steps the metrics are logged for
+	bool due(unsigned int step) const
+	{
+		return enabled && step % every == 0;
+	};
+
+	// copies the reduced metrics of step (on a map of pixels pixels) out of
+	// metricsBuffer, the row is written once the copy landed
+	void queue(unsigned int metricsBuffer, unsigned int step, unsigned int pixels)
+	{
+		if (!enabled)
+			return;
+
+		// write out every row that has already landed, without waiting
+		while (pending > 0 && writeOldest(false));
+
+		// the ring is full, the oldest row has to be written before reuse
+		if (pending == (int)slots.size())
+			writeOldest(true);
+
+		readbackSlot &slot = slots[head];
+		head = (head + 1) % slots.size();
+		pending++;
+
+		slot.step = step;
+		slot.pixels = pixels;
+		glCopyNamedBufferSubData(metricsBuffer, slot.buffer, 0, 0, sizeof(metricsBlock));
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	};
+
+	// writes the rows still in flight and closes the csv
+	void finish()
+	{
+		if (!enabled)
+			return;
+
+		while (pending > 0)
+			writeOldest(true);
+
+		for (readbackSlot &slot : slots)
+			glDeleteBuffers(1, &slot.buffer);
+		slots.clear();
+
+		csv.close();
+		enabled = false;
+	};
+
+private:
+	struct readbackSlot {
+		unsigned int buffer = 0;
+		GLsync fence = 0;
+		unsigned int step = 0;
+		unsigned int pixels = 0;
+	};
+
+	std::vector<readbackSlot> slots;
+	int head = 0;
+	int pending = 0;
+	int every = 1;
+
+	std::ofstream csv;
+
+	bool writeOldest(bool wait)
+	{
+		readbackSlot &slot = slots[(head + slots.size() - pending) % slots.size()];
+
+		GLuint64 timeout = wait ? 1000000000ull : 0;
+		GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+		if (status == GL_TIMEOUT_EXPIRED && !wait)
+			return false;
+
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+		pending--;
+
+		metricsBlock block;
+		glGetNamedBufferSubData(slot.buffer, 0, sizeof(block), &block);
+
+		csv << slot.step << "," << block.mass << "," << (double)block.covered / std::max(1u, slot.pixels)
+			<< "," << block.agents << "," << block.resets;
+		for (unsigned int count : block.density)
+			csv << "," << count;
+		for (unsigned int count : block.headings)
+			csv << "," << count;
+		csv << "\n";
+
+		return true;
+	};
+};
+#endif
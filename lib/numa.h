@@ -0,0 +1,177 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#elif defined(_WIN32)
+#include <Windows.h>
+#endif
+
+// NUMA nodes and their CPUs
+// -------------------------
+// read from /sys on linux, without libnuma, everything else (and linux
+// without the files) counts as one node holding every CPU
+struct numaTopology {
+	std::vector<std::vector<int>> nodeCpus;
+
+	static numaTopology read()
+	{
+		numaTopology topology;
+
+		#ifdef __linux__
+		for (int node = 0; ; node++)
+		{
+			std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+			if (!file)
+				break;
+
+			std::string list;
+			std::getline(file, list);
+			topology.nodeCpus.push_back(parseCpuList(list));
+		}
+		#endif
+
+		if (topology.nodeCpus.empty())
+		{
+			int cpus = std::max(1u, std::thread::hardware_concurrency());
+			topology.nodeCpus.emplace_back();
+			for (int cpu = 0; cpu < cpus; cpu++)
+				topology.nodeCpus[0].push_back(cpu);
+		}
+		return topology;
+	};
+
+	int nodes() const
+	{
+		return (int)nodeCpus.size();
+	};
+
+	int nodeOfCpu(int cpu) const
+	{
+		for (int node = 0; node < nodes(); node++)
+			if (std::find(nodeCpus[node].begin(), nodeCpus[node].end(), cpu) != nodeCpus[node].end())
+				return node;
+		return 0;
+	};
+
+	// CPU for every worker, consecutive workers (and so neighbouring bands
+	// of rows) share a node, the workers are split over the nodes with CPUs
+	// in proportion to their CPU counts
+	std::vector<int> workerCpus(int workers) const
+	{
+		std::vector<int> cpus;
+		int total = 0;
+		for (const std::vector<int> &node : nodeCpus)
+			total += (int)node.size();
+
+		for (int worker = 0; worker < workers; worker++)
+		{
+			// position of the worker among all CPUs, then that CPU's node
+			int position = (int)((long long)worker * total / workers);
+			for (const std::vector<int> &node : nodeCpus)
+			{
+				if (position < (int)node.size())
+				{
+					cpus.push_back(node[position]);
+					break;
+				}
+				position -= (int)node.size();
+			}
+		}
+		return cpus;
+	};
+
+	// "0-3,8-11" style lists
+	static std::vector<int> parseCpuList(const std::string &list)
+	{
+		std::vector<int> cpus;
+		std::stringstream ranges(list);
+		std::string range;
+
+		while (std::getline(ranges, range, ','))
+		{
+			if (range.empty())
+				continue;
+
+			size_t dash = range.find('-');
+			int first = std::stoi(range.substr(0, dash));
+			int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+			for (int cpu = first; cpu <= last; cpu++)
+				cpus.push_back(cpu);
+		}
+		return cpus;
+	};
+};
+
+// keeps the calling thread on one CPU, or lets it run on any again for
+// cpu < 0, false if the system doesn't allow it
+inline bool pinThread(int cpu)
+{
+	#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	if (cpu >= 0)
+	{
+		CPU_SET(cpu, &set);
+	}
+	else
+	{
+		for (int any = 0; any < CPU_SETSIZE; any++)
+			CPU_SET(any, &set);
+	}
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+	#elif defined(_WIN32)
+	DWORD_PTR process, system;
+	GetProcessAffinityMask(GetCurrentProcess(), &process, &system);
+	return SetThreadAffinityMask(GetCurrentThread(), cpu >= 0 ? (DWORD_PTR)1 << cpu : process) != 0;
+	#else
+	return false;
+	#endif
+}
+
+// CPU the calling thread runs on right now, -1 if unknown
+inline int currentCpu()
+{
+	#ifdef __linux__
+	return sched_getcpu();
+	#elif defined(_WIN32)
+	return (int)GetCurrentProcessorNumber();
+	#else
+	return -1;
+	#endif
+}
+
+const size_t numaPageBytes = 4096;
+
+// node of every page in [start, start + bytes), -1 for pages the system
+// doesn't say (not touched yet, or no way to ask outside of linux)
+inline void pageNodes(const void *start, size_t bytes, std::vector<int> &nodes)
+{
+	uintptr_t first = (uintptr_t)start / numaPageBytes * numaPageBytes;
+	uintptr_t end = (uintptr_t)start + bytes;
+	size_t count = bytes == 0 ? 0 : (end - first + numaPageBytes - 1) / numaPageBytes;
+
+	nodes.assign(count, -1);
+
+	#ifdef __linux__
+	std::vector<void*> pages(count);
+	for (size_t page = 0; page < count; page++)
+		pages[page] = (void*)(first + page * numaPageBytes);
+
+	// move_pages without target nodes only reports where the pages are
+	if (count > 0 && syscall(SYS_move_pages, 0, count, pages.data(), NULL, nodes.data(), 0) != 0)
+		nodes.assign(count, -1);
+	#endif
+}
+#endif
@@ -0,0 +1,300 @@
+#ifndef PASS_GRAPH_H
+#define PASS_GRAPH_H
+
+#include <glad/glad.h>
+
+#include <map>
+#include <tuple>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+
+// how a pass reaches a resource, decides the barrier bit that makes earlier
+// shader writes visible to it
+enum class gpuUse {
+	image,         // imageLoad/imageStore/atomics through an image unit
+	storage,       // shader storage block
+	sampler,       // texture()/textureLod() through a texture unit
+	indirect,      // dispatch arguments
+	textureUpdate, // GL calls on a texture, clears, copies, reads
+	bufferUpdate   // GL calls on a buffer, clears, copies, reads
+};
+
+// one resource a pass touches, the GL name is looked up every time the pass
+// runs, so ping-ponged and reallocated textures and buffers need nothing
+struct passAccess {
+	gpuUse use;
+	std::function<unsigned int()> object;
+	bool reads = true;
+	bool writes = false;
+	int unit = -1; // image unit, texture unit or storage binding
+
+	// image units only
+	GLenum format = GL_NONE;
+	int level = 0;
+	bool layered = false;
+
+	// storage only, size 0 binds all of it
+	GLintptr offset = 0;
+	GLsizeiptr size = 0;
+};
+
+// GL name kept in a variable, read when the pass runs
+inline std::function<unsigned int()> glObject(const unsigned int &name)
+{
+	return [&name]() { return name; };
+}
+
+inline passAccess imageAccess(int unit, std::function<unsigned int()> texture, GLenum format, bool reads, bool writes, int level = 0, bool layered = false)
+{
+	passAccess access{gpuUse::image, std::move(texture), reads, writes, unit};
+	access.format = format;
+	access.level = level;
+	access.layered = layered;
+	return access;
+}
+
+inline passAccess storageAccess(int binding, std::function<unsigned int()> buffer, bool reads, bool writes, GLintptr offset = 0, GLsizeiptr size = 0)
+{
+	passAccess access{gpuUse::storage, std::move(buffer), reads, writes, binding};
+	access.offset = offset;
+	access.size = size;
+	return access;
+}
+
+inline passAccess samplerAccess(int unit, std::function<unsigned int()> texture)
+{
+	return passAccess{gpuUse::sampler, std::move(texture), true, false, unit};
+}
+
+inline passAccess indirectAccess(std::function<unsigned int()> buffer)
+{
+	return passAccess{gpuUse::indirect, std::move(buffer), true, false};
+}
+
+inline passAccess textureUpdate(std::function<unsigned int()> texture, bool writes)
+{
+	return passAccess{gpuUse::textureUpdate, std::move(texture), !writes, writes};
+}
+
+inline passAccess bufferUpdate(std::function<unsigned int()> buffer, bool writes)
+{
+	return passAccess{gpuUse::bufferUpdate, std::move(buffer), !writes, writes};
+}
+
+class passGraph
+{
+	// GPU passes and the resources they declare
+	// -----------------------------------------
+	// every pass lists what it reads and writes and how (see passAccess),
+	// running passes binds those resources and puts in a barrier with only
+	// the bits the pass needs for resources a shader wrote before it, then
+	// runs the pass' own commands (use the program, set uniforms, dispatch)
+	// writes by GL calls (clears, copies) are ordered by GL itself, only
+	// shader writes (images, storage) leave a resource waiting for barriers,
+	// one bit per way it's read later on, and a barrier covers every
+	// resource written before it
+	// within one run() a binding that's already in place isn't made again,
+	// between runs others may have bound anything, so the first pass binds all
+	// a new pass only declares its resources, the barriers follow from them
+public:
+	struct pass {
+		std::string name;
+		std::vector<passAccess> accesses;
+		std::function<void()> work;
+
+		// passes can be left out for a step, e.g. pyramid levels the sensors don't need
+		std::function<bool()> enabled;
+	};
+
+	// adds a pass, returns its index for run()
+	int add(const std::string &name, std::vector<passAccess> accesses, std::function<void()> work, std::function<bool()> enabled = nullptr)
+	{
+		passes.push_back({name, std::move(accesses), std::move(work), std::move(enabled)});
+		return (int)passes.size() - 1;
+	};
+
+	size_t size() const
+	{
+		return passes.size();
+	};
+
+	// forgets the passes, after a barrier for the writes still waiting, so GL
+	// calls on the resources (uploads, clears, deleting them) are safe
+	void clear()
+	{
+		GLbitfield barrier = 0;
+		for (auto &resource : pending)
+			barrier |= resource.second;
+		if (barrier != 0)
+			glMemoryBarrier(barrier);
+
+		passes.clear();
+		pending.clear();
+	};
+
+	// runs the passes in the given order
+	void run(const std::vector<int> &order)
+	{
+		boundImages.clear();
+		boundStorage.clear();
+		boundTextures.clear();
+		boundIndirect = -1;
+
+		for (int index : order)
+		{
+			pass &current = passes[index];
+			if (current.enabled && !current.enabled())
+				continue;
+
+			// names before the work, it may swap them for the next pass
+			std::vector<unsigned int> objects = resolve(current.accesses);
+
+			wait(current.accesses, objects);
+			bind(current.accesses, objects);
+			current.work();
+			written(current.accesses, objects);
+		}
+	};
+
+	void run(int index)
+	{
+		run(std::vector<int>{index});
+	};
+
+	// puts in the barrier GL calls outside any pass need, e.g. reading a
+	// texture back
+	void access(const std::vector<passAccess> &accesses)
+	{
+		std::vector<unsigned int> objects = resolve(accesses);
+		wait(accesses, objects);
+		written(accesses, objects);
+	};
+
+private:
+	std::vector<pass> passes;
+
+	// barrier bits each shader written resource still waits for, by
+	// (buffer, GL name), textures and buffers have separate names
+	std::map<std::pair<bool, unsigned int>, GLbitfield> pending;
+
+	// what run() bound so far
+	std::map<int, std::tuple<unsigned int, int, bool, GLenum, GLenum>> boundImages;
+	std::map<int, std::tuple<unsigned int, GLintptr, GLsizeiptr>> boundStorage;
+	std::map<int, unsigned int> boundTextures;
+	long long boundIndirect = -1;
+
+	// every way a shader write can be read afterwards
+	static const GLbitfield readBits = GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT |
+		GL_TEXTURE_FETCH_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT;
+
+	static GLbitfield barrierBit(gpuUse use)
+	{
+		switch (use)
+		{
+		case gpuUse::image: return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+		case gpuUse::storage: return GL_SHADER_STORAGE_BARRIER_BIT;
+		case gpuUse::sampler: return GL_TEXTURE_FETCH_BARRIER_BIT;
+		case gpuUse::indirect: return GL_COMMAND_BARRIER_BIT;
+		case gpuUse::textureUpdate: return GL_TEXTURE_UPDATE_BARRIER_BIT;
+		case gpuUse::bufferUpdate: return GL_BUFFER_UPDATE_BARRIER_BIT;
+		}
+		return 0;
+	};
+
+	static bool isBuffer(gpuUse use)
+	{
+		return use == gpuUse::storage || use == gpuUse::indirect || use == gpuUse::bufferUpdate;
+	};
+
+	static std::vector<unsigned int> resolve(const std::vector<passAccess> &accesses)
+	{
+		std::vector<unsigned int> objects;
+		for (const passAccess &access : accesses)
+			objects.push_back(access.object());
+		return objects;
+	};
+
+	void wait(const std::vector<passAccess> &accesses, const std::vector<unsigned int> &objects)
+	{
+		GLbitfield barrier = 0;
+		for (size_t index = 0; index < accesses.size(); index++)
+		{
+			auto found = pending.find({isBuffer(accesses[index].use), objects[index]});
+			if (found != pending.end())
+				barrier |= found->second & barrierBit(accesses[index].use);
+		}
+
+		if (barrier == 0)
+			return;
+
+		glMemoryBarrier(barrier);
+		for (auto &resource : pending)
+			resource.second &= ~barrier;
+	};
+
+	void written(const std::vector<passAccess> &accesses, const std::vector<unsigned int> &objects)
+	{
+		for (size_t index = 0; index < accesses.size(); index++)
+		{
+			const passAccess &access = accesses[index];
+			if (access.writes && (access.use == gpuUse::image || access.use == gpuUse::storage))
+				pending[{isBuffer(access.use), objects[index]}] = readBits;
+		}
+	};
+
+	void bind(const std::vector<passAccess> &accesses, const std::vector<unsigned int> &objects)
+	{
+		for (size_t index = 0; index < accesses.size(); index++)
+		{
+			const passAccess &access = accesses[index];
+			unsigned int object = objects[index];
+
+			if (access.use == gpuUse::image)
+			{
+				GLenum mode = access.reads && access.writes ? GL_READ_WRITE : access.writes ? GL_WRITE_ONLY : GL_READ_ONLY;
+				auto state = std::make_tuple(object, access.level, access.layered, mode, access.format);
+
+				auto found = boundImages.find(access.unit);
+				if (found == boundImages.end() || found->second != state)
+				{
+					glBindImageTexture(access.unit, object, access.level, access.layered ? GL_TRUE : GL_FALSE, 0, mode, access.format);
+					boundImages[access.unit] = state;
+				}
+			}
+			else if (access.use == gpuUse::storage)
+			{
+				auto state = std::make_tuple(object, access.offset, access.size);
+
+				auto found = boundStorage.find(access.unit);
+				if (found == boundStorage.end() || found->second != state)
+				{
+					if (access.size > 0)
+						glBindBufferRange(GL_SHADER_STORAGE_BUFFER, access.unit, object, access.offset, access.size);
+					else
+						glBindBufferBase(GL_SHADER_STORAGE_BUFFER, access.unit, object);
+					boundStorage[access.unit] = state;
+				}
+			}
+			else if (access.use == gpuUse::sampler)
+			{
+				auto found = boundTextures.find(access.unit);
+				if (found == boundTextures.end() || found->second != object)
+				{
+					glBindTextureUnit(access.unit, object);
+					boundTextures[access.unit] = object;
+				}
+			}
+			else if (access.use == gpuUse::indirect)
+			{
+				if (boundIndirect != (long long)object)
+				{
+					glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, object);
+					boundIndirect = object;
+				}
+			}
+		}
+	};
+};
+#endif
@@ -4,10 +4,68 @@
 #include <glad/glad.h>
 
 #include <string>
+#include <vector>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 
+inline std::string preprocessShader(const std::string &code, const std::string &path, const std::vector<std::string> &defines)
+{
+	// resolves #include "file" lines (relative to the including shader) and
+	// adds a #define for every entry in defines right after the #version line
+	// ------------------------------------------------------------------------
+	std::string directory = path.substr(0, path.find_last_of("/\\") + 1);
+
+	std::stringstream input(code);
+	std::stringstream output;
+	std::string line;
+	int lineNumber = 0;
+
+	while (std::getline(input, line))
+	{
+		lineNumber++;
+
+		if (line.rfind("#include", 0) == 0)
+		{
+			size_t first = line.find('"');
+			size_t last = line.find_last_of('"');
+			std::string includePath = directory + line.substr(first + 1, last - first - 1);
+
+			std::ifstream includeFile(includePath);
+			if (!includeFile)
+			{
+				std::cout << "ERROR::SHADER::INCLUDE_NOT_FOUND " << includePath << std::endl;
+				continue;
+			}
+			std::stringstream includeStream;
+			includeStream << includeFile.rdbuf();
+
+			output << preprocessShader(includeStream.str(), includePath, {}) << "\n";
+			output << "#line " << lineNumber + 1 << "\n";
+			continue;
+		}
+
+		output << line << "\n";
+
+		if (line.rfind("#version", 0) == 0)
+		{
+			for (const std::string &define : defines)
+				output << "#define " << define << "\n";
+			output << "#line " << lineNumber + 1 << "\n";
+		}
+	}
+
+	return output.str();
+}
+
+// files and defines of one shader program, either vertex + fragment or compute
+struct shaderSource {
+	std::string vertexPath;
+	std::string fragmentPath;
+	std::string computePath;
+	std::vector<std::string> defines;
+};
+
 class vertFragShader
 {
 	//shader class that builds a program out of vert and frag shader code
@@ -16,8 +74,11 @@ public:
 	// Program ID
 	unsigned int ID;
 
+	// false if reading, compiling or linking failed
+	bool valid = false;
+
 	// contructor for reading and building shader
-	vertFragShader(const char* vertexPath, const char* fragmentPath)
+	vertFragShader(const char* vertexPath, const char* fragmentPath, const std::vector<std::string> &defines = {})
 	{
 		// get source code from file paths
 		std::string vertexCode;
@@ -41,8 +102,8 @@ public:
 			vShaderFile.close();
 			fShaderFile.close();
 			// convert stream into string
-			vertexCode = vShaderStream.str();
-			fragmentCode = fShaderStream.str();
+			vertexCode = preprocessShader(vShaderStream.str(), vertexPath, defines);
+			fragmentCode = preprocessShader(fShaderStream.str(), fragmentPath, defines);
 		}
 		catch(std::ifstream::failure e)
 		{
@@ -92,6 +153,7 @@ public:
 			glGetProgramInfoLog(ID, 512, NULL, infoLog);
 			std::cout<<"ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
 		}
+		valid = success;
 
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
@@ -112,10 +174,22 @@ public:
 	{
 		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
 	};
+	void setUint(const std::string &name, unsigned int value) const
+	{
+		glUniform1ui(glGetUniformLocation(ID, name.c_str()), value);
+	};
 	void setFloat(const std::string &name, float value) const
 	{
 		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
 	};
+	void setVec2(const std::string &name, float val1, float val2) const
+	{
+		glUniform2f(glGetUniformLocation(ID, name.c_str()), val1, val2);
+	};
+	void setIvec2(const std::string &name, int val1, int val2) const
+	{
+		glUniform2i(glGetUniformLocation(ID, name.c_str()), val1, val2);
+	};
 	void setVec4(const std::string &name, float val1, float val2, float val3, float val4) const
 	{
 		glUniform4f(glGetUniformLocation(ID, name.c_str()), val1, val2, val3, val4);
@@ -130,8 +204,11 @@ public:
 	// Program ID
 	unsigned int ID;
 
+	// false if reading, compiling or linking failed
+	bool valid = false;
+
 	// contructor for reading and building shader
-	computeShader(const char* computePath)
+	computeShader(const char* computePath, const std::vector<std::string> &defines = {})
 	{
 		// get source code from file paths
 		std::string computeCode;
@@ -149,7 +226,7 @@ public:
 			// close file
 			cShaderFile.close();
 			// convert stream into string
-			computeCode = cShaderStream.str();
+			computeCode = preprocessShader(cShaderStream.str(), computePath, defines);
 		}
 		catch(std::ifstream::failure e)
 		{
@@ -185,6 +262,7 @@ public:
 			glGetProgramInfoLog(ID, 512, NULL, infoLog);
 			std::cout<<"ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
 		}
+		valid = success;
 
 		glDeleteShader(compute);
 	};
@@ -195,9 +273,9 @@ public:
 		glUseProgram(ID);
 	};
 
-	void dispatch(int width, int height)
+	void dispatch(int width, int height, int depth = 1)
 	{
-		glDispatchCompute(width, height, 1);
+		glDispatchCompute(width, height, depth);
 	}
 
 	// utility functions
@@ -209,10 +287,22 @@ public:
 	{
 		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
 	};
+	void setUint(const std::string &name, unsigned int value) const
+	{
+		glUniform1ui(glGetUniformLocation(ID, name.c_str()), value);
+	};
 	void setFloat(const std::string &name, float value) const
 	{
 		glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
 	};
+	void setVec2(const std::string &name, float val1, float val2) const
+	{
+		glUniform2f(glGetUniformLocation(ID, name.c_str()), val1, val2);
+	};
+	void setIvec2(const std::string &name, int val1, int val2) const
+	{
+		glUniform2i(glGetUniformLocation(ID, name.c_str()), val1, val2);
+	};
 	void setVec4(const std::string &name, float val1, float val2, float val3, float val4) const
 	{
 		glUniform4f(glGetUniformLocation(ID, name.c_str()), val1, val2, val3, val4);
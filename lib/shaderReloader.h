@@ -0,0 +1,161 @@
+#ifndef SHADER_RELOADER_H
+#define SHADER_RELOADER_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <iostream>
+
+#include "shader.h"
+
+class shaderReloader
+{
+	// rebuilds the running shader programs on a worker thread
+	// -------------------------------------------------------
+	// the worker owns a hidden context sharing objects with the main one, so
+	// compiling never stalls the frame loop, the main loop only swaps program
+	// IDs once all new programs have linked, a failed build changes nothing
+public:
+	shaderReloader(GLFWwindow *mainWindow)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		context = glfwCreateWindow(1, 1, "shader compiler", NULL, mainWindow);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+		if (context == NULL)
+		{
+			std::cout << "Failed to create shader compiler context, shaders won't be hot reloaded" << std::endl;
+			return;
+		}
+
+		worker = std::thread(&shaderReloader::compileLoop, this);
+	};
+
+	~shaderReloader()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wakeUp.notify_one();
+
+		if (worker.joinable())
+			worker.join();
+
+		if (context != NULL)
+			glfwDestroyWindow(context);
+	};
+
+	shaderReloader(const shaderReloader&) = delete;
+	shaderReloader& operator=(const shaderReloader&) = delete;
+
+	// queues a rebuild, replaces an older request that hasn't started yet
+	void request(const std::vector<shaderSource> &sources)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pending = sources;
+			hasPending = true;
+		}
+		wakeUp.notify_one();
+	};
+
+	// true once a requested rebuild linked, programs holds one new program per
+	// requested source (in order), the caller owns them and has to delete the
+	// ones they replace
+	bool finished(std::vector<unsigned int> &programs)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!hasResult)
+			return false;
+
+		programs = result;
+		hasResult = false;
+		return true;
+	};
+
+private:
+	GLFWwindow *context = NULL;
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+
+	std::vector<shaderSource> pending;
+	bool hasPending = false;
+	bool stopping = false;
+
+	bool hasResult = false;
+	std::vector<unsigned int> result;
+
+	void compileLoop()
+	{
+		glfwMakeContextCurrent(context);
+
+		while (true)
+		{
+			std::vector<shaderSource> current;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wakeUp.wait(lock, [this]() { return hasPending || stopping; });
+				if (stopping)
+					break;
+
+				current = pending;
+				hasPending = false;
+			}
+
+			std::vector<unsigned int> programs;
+			bool valid = true;
+			for (const shaderSource &source : current)
+			{
+				if (source.computePath.empty())
+				{
+					vertFragShader shader(source.vertexPath.c_str(), source.fragmentPath.c_str(), source.defines);
+					programs.push_back(shader.ID);
+					valid = valid && shader.valid;
+				}
+				else
+				{
+					computeShader shader(source.computePath.c_str(), source.defines);
+					programs.push_back(shader.ID);
+					valid = valid && shader.valid;
+				}
+			}
+
+			// the programs have to be complete before another context uses them
+			glFinish();
+
+			if (!valid)
+			{
+				std::cout << "Shader reload failed, keeping the running shaders." << std::endl;
+				for (unsigned int program : programs)
+					glDeleteProgram(program);
+				continue;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				// a result nobody picked up yet is replaced by the newer one
+				if (hasResult)
+				{
+					for (unsigned int program : result)
+						glDeleteProgram(program);
+				}
+				result = programs;
+				hasResult = true;
+			}
+
+			// a paused main loop blocks in glfwWaitEvents(), wake it to swap them in
+			glfwPostEmptyEvent();
+		}
+
+		glfwMakeContextCurrent(NULL);
+	};
+};
+#endif
@@ -0,0 +1,1246 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <glad/glad.h>
+
+#define _USE_MATH_DEFINES // to get M_PI
+#include <math.h>
+#include <iostream>
+#include <vector>
+#include <random>
+#include <string>
+#include <memory>
+#include <algorithm>
+
+#include "json.hpp"
+using json = nlohmann::json;
+
+#include "shader.h"
+#include "passGraph.h"
+#include "metrics.h"
+
+
+// settings struct for the shaders, has to match settingsStruct in them
+// --------------------------------------------------------------------
+struct simulationSettings {
+	// agent settings
+	// --------------
+	float moveSpeed;
+	float turnSpeed;
+	float sensorAngle;
+	float sensorDistance;
+
+	// map size settings
+	// ------------
+	int width;
+	int height;
+
+	// diffusion and decay settings
+	// ----------------------------
+	float color_r;
+	float color_g;
+	float color_b;
+	float decayRate;
+	float diffuseRate;
+
+	// sensing settings
+	// ----------------
+	int sensorSize;
+};
+
+struct agent {
+	float x;
+	float y;
+	float angle; // radians
+};
+
+// agent of the heading vector layout, has to match agent in the shaders
+// built with HEADING_VECTOR
+struct headingAgent {
+	float x;
+	float y;
+	float headingX; // unit vector the agent moves along
+	float headingY;
+};
+
+// agent of the packed layout, 8 bytes instead of 12, has to match
+// shaders/packedAgent.glsl: x and y are 16.8 fixed point in the low 24 bits
+// of their word, the angle is 16 bits of a full turn split over the top
+// bytes of both
+struct packedAgent {
+	unsigned int xAngle; // x, high byte of the angle on top
+	unsigned int yAngle; // y, low byte of the angle on top
+};
+
+inline packedAgent packAgent(const agent &unpacked)
+{
+	auto fixedPoint = [](float position) { return (unsigned int)std::min(16777215.0f, std::max(0.0f, position * 256.0f + 0.5f)); };
+
+	double turns = unpacked.angle / (2 * M_PI);
+	unsigned int angle = (unsigned int)((turns - std::floor(turns)) * 65536.0 + 0.5) & 0xFFFF;
+
+	return {fixedPoint(unpacked.x) | (angle >> 8) << 24, fixedPoint(unpacked.y) | (angle & 0xFF) << 24};
+}
+
+
+inline unsigned int presetSeed(const json &preset)
+{
+	// a "seed" in the preset makes every run start (and continue) identically
+	if (preset.contains("seed"))
+		return preset["seed"];
+
+	std::random_device rd;
+	return rd();
+}
+
+// one agent placed by spawnMethod, randomUnit() returns values in [0, 1)
+template <typename randomFunction>
+inline agent spawnAgent(const json &spawnMethod, unsigned int width, unsigned int height, randomFunction &randomUnit)
+{
+	agent t;
+
+	int centreX = width / 2;
+	int centreY = height / 2;
+
+	// spawns all agents in the middle, with random angles
+	if (spawnMethod == "centre")
+	{
+		t.x = centreX;
+		t.y = centreY;
+		t.angle = randomUnit() * 12.5662;
+	}
+	// spawns all agents in the area of a circle with angles
+	// facing towards screen centre
+	else if (spawnMethod == "circle")
+	{
+		int radius = height / 3;
+
+		int distance = int(randomUnit() * (radius + 1));
+		float genAngle = randomUnit() * 6.2831;
+
+		t.x = centreX + (cos(genAngle) * distance);
+		t.y = centreY + (sin(genAngle) * distance);
+
+		// get angle that is towards the circle centre
+		t.angle = genAngle + M_PI;
+	}
+	// spawns all agents with random angles and random position
+	else if (spawnMethod == "random")
+	{
+		t.x = int(randomUnit() * (width + 1));
+		t.y = int(randomUnit() * (height + 1));
+
+		t.angle = randomUnit() * 6.2831;
+	}
+
+	return t;
+}
+
+inline void createAgents(const json &preset, unsigned int width, unsigned int height, unsigned int seed, agent *agents)
+{
+	// setup random device for angle, position, etc.. customization
+	// these devices are part of c++ random value generation
+	unsigned int agentNumber = preset["agentNumber"];
+	std::mt19937 gen(seed);
+
+	// mt19937 output is the same on every platform, std distributions are not
+	auto randomUnit = [&gen]() { return gen() / 4294967296.0; };
+
+	// initialize each agent with starting position and angle
+	// they are determined by user defined settings in the selected preset
+	for (unsigned int i = 0; i < agentNumber; i++)
+		agents[i] = spawnAgent(preset["spawnMethod"], width, height, randomUnit);
+}
+
+// copies settings from the preset into a settings struct
+inline simulationSettings readSimulationSettings(const json &preset)
+{
+	simulationSettings settings;
+
+	// can't assign values to variables above from the json
+	// file so i have to do the assigning bellow
+	settings.moveSpeed = preset["moveSpeed"];
+	settings.turnSpeed = preset["turnSpeed"];
+	settings.sensorAngle = preset["sensorAngle"];
+	settings.sensorDistance = preset["sensorDistance"];
+
+	settings.width = preset["mapWidth"];
+	settings.height = preset["mapHeight"];
+
+	settings.color_r = preset["color_r"];
+	settings.color_r /= 255.0f;
+	settings.color_g = preset["color_g"];
+	settings.color_g /= 255.0f;
+	settings.color_b = preset["color_b"];
+	settings.color_b /= 255.0f;
+	settings.decayRate = preset["decayRate"];
+	settings.diffuseRate = preset["diffuseRate"];
+
+	settings.sensorSize = preset.value("sensorSize", 1);
+
+	return settings;
+}
+
+
+// true when the preset's single map diffusion only runs on active tiles,
+// the default for stageFinal (the only shader that flags deposited tiles)
+inline bool sparseTiles(const json &preset)
+{
+	return preset.value("sparseTiles", true) && preset["simulationShader"] == "stageFinal";
+}
+
+// true when agents of the preset's single map spawn and despawn while it
+// runs, needs stageFinal (the only shader with the despawn rules)
+inline bool dynamicPopulation(const json &preset)
+{
+	return preset["simulationShader"] == "stageFinal"
+		&& (preset.contains("targetAgents") || preset.contains("agentLifetime") || preset.contains("starveSteps"));
+}
+
+// true when agents of the preset's single map sense from a mip pyramid of
+// the trail instead of summing every pixel of their sensor box
+inline bool mipSensing(const json &preset)
+{
+	return preset.value("sensing", "taps") == "mip" && preset["simulationShader"] == "stageFinal";
+}
+
+// true when agents of the preset's single map read their sensor boxes from a
+// summed-area table of the trail
+inline bool satSensing(const json &preset)
+{
+	return preset.value("sensing", "taps") == "sat" && preset["simulationShader"] == "stageFinal";
+}
+
+// true when agents of the preset's single map are packed into 8 bytes, the
+// fixed point positions only reach 65536 pixels
+inline bool packedAgents(const json &preset)
+{
+	return preset.value("agentFormat", "float") == "packed" && preset["simulationShader"] == "stageFinal"
+		&& preset["mapWidth"] <= 65536 && preset["mapHeight"] <= 65536;
+}
+
+// true when agents of the preset's single map store their heading as a unit
+// vector instead of an angle, packed agents always store an angle
+inline bool headingVectors(const json &preset)
+{
+	return preset.value("heading", "angle") == "vector" && preset["simulationShader"] == "stageFinal" && !packedAgents(preset);
+}
+
+// true when the preset's single map logs per step metrics, the edge resets
+// are counted by stageFinal
+inline bool measuredMetrics(const json &preset)
+{
+	return preset.value("metricsOutput", "") != "" && preset["simulationShader"] == "stageFinal";
+}
+
+// whole screen rectangle for the vertex + fragment passes
+inline void createScreenQuad(unsigned int &VAO, unsigned int &VBO, unsigned int &EBO)
+{
+	// set up vertex data and buffers
+	// ------------------------------
+	float rectangleVertices[] = {
+		// rectangle is made from 2 triangles
+		// positions        // colors          // texture coords
+		1.0f,  1.0f, 0.0f,  1.0f, 0.0f, 0.0f,  1.0f, 1.0f, // top right
+		1.0f, -1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  1.0f, 0.0f, // bot right
+	   -1.0f, -1.0f, 0.0f,  0.0f, 0.0f, 0.0f,  0.0f, 0.0f, // bot left
+	   -1.0f,  1.0f, 0.0f,  0.0f, 0.0f, 1.0f,  0.0f, 1.0f // top left
+	};
+
+	unsigned int indices[] = { // order for drawing vertices
+		0, 1, 3, // first trinagle
+		1, 2, 3  // second triangle
+	};
+
+
+	// general VBO, VAO, EBO setup using data above
+	// --------------------------------------------
+	glGenVertexArrays(1, &VAO);
+	glGenBuffers(1, &VBO);
+	glGenBuffers(1, &EBO);
+
+	// bind vertex array object first, then bind and set vertex buffer, then configure vertex attributes
+	glBindVertexArray(VAO);
+
+	glBindBuffer(GL_ARRAY_BUFFER, VBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(rectangleVertices), rectangleVertices, GL_STATIC_DRAW);
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+	// configure vertex attributes
+	// ---------------------------
+	// position attrib
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float),  (void*)0);
+	glEnableVertexAttribArray(0);
+
+	// color attrib
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float),  (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+
+	// texture coord attrib
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float),  (void*)(6 * sizeof(float)));
+	glEnableVertexAttribArray(2);
+
+	// unbind VAO, saving all buffers into it, then unbind buffers
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+
+class slimeSimulation
+{
+	// all GPU state of a simulation: trail, deposit, settings and agents
+	// ------------------------------------------------------------------
+	// load() can be called again with another preset, textures and buffers
+	// are only reallocated when the map size or agent count changes
+	// with sparse tiles diffusion only runs on the 8x8 tiles listed as active
+	// by the step before, so untouched parts of the map cost nothing
+	// with a dynamic population agentNumber is only the starting count, the
+	// live count stays on the GPU, see shaders/population.glsl
+public:
+	unsigned int width = 0;
+	unsigned int height = 0;
+	unsigned int agentNumber = 0;
+	unsigned int agentCapacity = 0;
+	unsigned int seed = 0;
+
+	// simulation step counter, drives the random streams in the shaders
+	unsigned int frameIndex = 0;
+
+	simulationSettings settings;
+
+	// the trail is ping-ponged, the diffusion reads trailTextures[currentTrail]
+	// and writes the diffused result into the other one
+	unsigned int trailTextures[2] = {0, 0};
+	unsigned int depositTexture = 0;
+	int currentTrail = 0;
+
+	unsigned int settingsSSBO = 0;
+	unsigned int agentDataSSBO = 0;
+
+	// sparse diffusion state, see shaders/tiles.glsl
+	bool sparse = false;
+	unsigned int tilesX = 0;
+	unsigned int tilesY = 0;
+	unsigned int tileFlagSSBO = 0;
+	unsigned int tileHistorySSBO = 0;
+	unsigned int activeTileBuffer = 0;
+
+	// dynamic population state, the rules can change while running
+	bool dynamic = false;
+	unsigned int targetAgents = 0;
+	unsigned int agentLifetime = 0;
+	unsigned int starveSteps = 0;
+	int spawnMethod = 0;
+	unsigned int populationSSBO = 0;
+	unsigned int lifeSSBO = 0;
+
+	// mip sensing state, see shaders/pyramid.comp
+	bool mip = false;
+	unsigned int pyramidTexture = 0;
+	int pyramidLevels = 0;
+
+	// agents store a heading vector instead of an angle
+	bool vectorHeading = false;
+
+	// agents are packed into 8 bytes
+	bool packing = false;
+
+	// summed-area table sensing state, see shaders/sat.comp
+	bool sat = false;
+	unsigned int senseTableTexture = 0;
+
+	// per step metrics state, see lib/metrics.h
+	bool measuring = false;
+	stepMetrics metrics;
+	unsigned int metricsSSBO = 0;
+	unsigned int metricPartialSSBO = 0;
+
+	// whole screen rectangle the display shader is drawn on
+	unsigned int VAO = 0, VBO = 0, EBO = 0;
+
+	// every GPU pass of a step and the display, with the resources they use,
+	// rebuilt by load() for the features the preset turns on
+	passGraph passes;
+
+	slimeSimulation() {};
+
+	// the passes hold pointers into it
+	slimeSimulation(const slimeSimulation&) = delete;
+	slimeSimulation& operator=(const slimeSimulation&) = delete;
+
+	// reads the preset, (re)allocates what doesn't fit, clears the trail and spawns agents
+	void load(const json &preset)
+	{
+		if (VAO == 0)
+			createScreenQuad(VAO, VBO, EBO);
+
+		// the last run's shader writes land before anything is cleared or uploaded
+		passes.clear();
+
+		unsigned int newWidth = preset["mapWidth"];
+		unsigned int newHeight = preset["mapHeight"];
+		if (newWidth != width || newHeight != height)
+			createTextures(newWidth, newHeight);
+
+		readSettings(preset);
+
+		// clear the trail and deposits left over from a previous run, alpha
+		// is 1 like in every diffused pixel so skipped tiles read the same
+		float trailClear[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+		glClearTexImage(trailTextures[0], 0, GL_RGBA, GL_FLOAT, trailClear);
+		glClearTexImage(trailTextures[1], 0, GL_RGBA, GL_FLOAT, trailClear);
+		glClearTexImage(depositTexture, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &depositClear);
+		currentTrail = 0;
+		frameIndex = 0;
+
+		sparse = sparseTiles(preset);
+		if (sparse)
+			resetTiles();
+
+		dynamic = dynamicPopulation(preset);
+		vectorHeading = headingVectors(preset);
+		packing = packedAgents(preset);
+		spawnAgents(preset);
+		if (dynamic)
+			resetPopulation();
+
+		mip = mipSensing(preset);
+		if (mip)
+			resetPyramid();
+
+		sat = satSensing(preset);
+		if (sat)
+			resetSenseTable();
+
+		measuring = measuredMetrics(preset);
+		resetMetrics(preset);
+
+		buildPasses();
+	};
+
+	// copies settings from the preset into the settings SSBO
+	void readSettings(const json &preset)
+	{
+		settings = readSimulationSettings(preset);
+
+		targetAgents = preset.value("targetAgents", preset["agentNumber"].get<unsigned int>());
+		agentLifetime = preset.value("agentLifetime", 0u);
+		starveSteps = preset.value("starveSteps", 0u);
+
+		// same order as in spawnAgent()
+		spawnMethod = preset["spawnMethod"] == "centre" ? 0 : preset["spawnMethod"] == "circle" ? 1 : 2;
+
+		if (settingsSSBO == 0)
+		{
+			// create settings SSBO and put settings struct into it
+			glGenBuffers(1, &settingsSSBO);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, settingsSSBO);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(settings), &settings, GL_DYNAMIC_DRAW);
+		}
+		else
+		{
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, settingsSSBO);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(settings), &settings);
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	};
+
+	// one simulation step: diffuse the trail, then move the agents, see buildPasses()
+	void step(computeShader &diffuseShader, computeShader &agentShader)
+	{
+		diffuseProgram = &diffuseShader;
+		agentProgram = &agentShader;
+		passes.run(stepPasses);
+	};
+
+	// draws the trail (and where agents are) scaled to a viewportWidth x viewportHeight framebuffer
+	void display(vertFragShader &displayShader, int viewportWidth, int viewportHeight)
+	{
+		displayProgram = &displayShader;
+		displayWidth = viewportWidth;
+		displayHeight = viewportHeight;
+		passes.run(displayPass);
+	};
+
+	// tiles the next diffusion runs on (stalls, for timing output)
+	unsigned int activeTiles()
+	{
+		if (!sparse)
+			return ((width + 7) / 8) * ((height + 7) / 8);
+
+		unsigned int count;
+		passes.access({bufferUpdate(glObject(activeTileBuffer), false)});
+		glGetNamedBufferSubData(activeTileBuffer, 0, sizeof(count), &count);
+		return count;
+	};
+
+	// agents alive right now (stalls, for printing)
+	unsigned int liveAgents()
+	{
+		if (!dynamic)
+			return agentNumber;
+
+		unsigned int count;
+		passes.access({bufferUpdate(glObject(populationSSBO), false)});
+		glGetNamedBufferSubData(populationSSBO, 3 * sizeof(unsigned int), sizeof(count), &count);
+		return count;
+	};
+
+	// sources of the helper programs of the loaded modes (active tiles,
+	// compaction, pyramid, table, metrics), shader reloads rebuild them with
+	// the main programs so shared includes stay in step
+	std::vector<shaderSource> helperSources()
+	{
+		std::vector<shaderSource> sources;
+		for (auto &helper : helperPrograms())
+			sources.push_back(helper.second);
+		return sources;
+	};
+
+	// swaps in programs rebuilt from helperSources(), in its order, and
+	// deletes the ones they replace
+	void adoptHelperPrograms(const std::vector<unsigned int> &programs)
+	{
+		std::vector<std::pair<computeShader*, shaderSource>> helpers = helperPrograms();
+		if (programs.size() != helpers.size())
+		{
+			for (unsigned int program : programs)
+				glDeleteProgram(program);
+			return;
+		}
+
+		for (size_t index = 0; index < helpers.size(); index++)
+		{
+			glDeleteProgram(helpers[index].first->ID);
+			helpers[index].first->ID = programs[index];
+		}
+	};
+
+	// writes the metrics rows still in flight, while the GL context is still there
+	void finishMetrics()
+	{
+		metrics.finish();
+	};
+
+	// reads the current trail back as width * height rgba floats (stalls, for offline use)
+	void readTrail(std::vector<float> &pixels)
+	{
+		pixels.resize((size_t)width * height * 4);
+		passes.access({textureUpdate(glObject(trailTextures[currentTrail]), false)});
+		glGetTextureImage(trailTextures[currentTrail], 0, GL_RGBA, GL_FLOAT, pixels.size() * sizeof(float), pixels.data());
+	};
+
+private:
+	size_t allocatedAgentBytes = 0;
+	unsigned int depositClear = 0;
+
+	std::unique_ptr<computeShader> activeTileShader;
+	std::unique_ptr<computeShader> pyramidShader;
+	unsigned int pyramidWidth = 0;
+	unsigned int pyramidHeight = 0;
+
+	std::unique_ptr<computeShader> senseRowShader;
+	std::unique_ptr<computeShader> senseColumnShader;
+	unsigned int senseTableWidth = 0;
+	unsigned int senseTableHeight = 0;
+
+	// (re)allocates the summed-area table for the map size
+	void resetSenseTable()
+	{
+		if (!senseRowShader)
+		{
+			senseRowShader = std::make_unique<computeShader>("shaders/sat.comp", std::vector<std::string>{"ROWS"});
+			senseColumnShader = std::make_unique<computeShader>("shaders/sat.comp", std::vector<std::string>{"COLUMNS"});
+		}
+
+		if (senseTableTexture != 0 && senseTableWidth == width && senseTableHeight == height)
+			return;
+
+		if (senseTableTexture != 0)
+			glDeleteTextures(1, &senseTableTexture);
+
+		senseTableWidth = width;
+		senseTableHeight = height;
+
+		glCreateTextures(GL_TEXTURE_2D, 1, &senseTableTexture);
+		glTextureStorage2D(senseTableTexture, 1, GL_R32UI, width, height);
+	};
+
+	// (re)allocates the pyramid for the map size, level 0 is half of it
+	void resetPyramid()
+	{
+		if (!pyramidShader)
+			pyramidShader = std::make_unique<computeShader>("shaders/pyramid.comp");
+
+		if (pyramidTexture != 0 && pyramidWidth == width && pyramidHeight == height)
+			return;
+
+		if (pyramidTexture != 0)
+			glDeleteTextures(1, &pyramidTexture);
+
+		pyramidWidth = width;
+		pyramidHeight = height;
+
+		int levelWidth = std::max(1u, width / 2);
+		int levelHeight = std::max(1u, height / 2);
+		pyramidLevels = (int)std::floor(std::log2(std::max(levelWidth, levelHeight))) + 1;
+
+		glCreateTextures(GL_TEXTURE_2D, 1, &pyramidTexture);
+		glTextureStorage2D(pyramidTexture, pyramidLevels, GL_R32F, levelWidth, levelHeight);
+		glTextureParameteri(pyramidTexture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTextureParameteri(pyramidTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTextureParameteri(pyramidTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(pyramidTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	};
+
+	// compaction buffers and passes of the dynamic population, the agent and
+	// life buffers are ping-ponged with the spare ones every step
+	// has to match SCAN_BLOCK in shaders/population.comp
+	static const unsigned int scanBlock = 256;
+	unsigned int spareAgentSSBO = 0;
+	unsigned int spareLifeSSBO = 0;
+	unsigned int aliveSSBO = 0;
+	unsigned int offsetSSBO = 0;
+	unsigned int blockSumSSBO = 0;
+	std::unique_ptr<computeShader> scanBlocksShader;
+	std::unique_ptr<computeShader> scanTotalsShader;
+	std::unique_ptr<computeShader> scatterShader;
+	std::vector<std::string> populationLayout;
+
+	void setPopulationUniforms(computeShader &shader)
+	{
+		shader.setUint("targetAgents", targetAgents);
+		shader.setUint("agentLifetime", agentLifetime);
+		shader.setUint("starveSteps", starveSteps);
+	};
+
+	// defines the passes reading agents need to agree with the agent pass on their layout
+	std::vector<std::string> agentLayout()
+	{
+		std::vector<std::string> layout;
+		if (vectorHeading)
+			layout.push_back("HEADING_VECTOR");
+		if (packing)
+			layout.push_back("PACKED_AGENTS");
+		return layout;
+	};
+
+	// sizes the compaction buffers to agentCapacity, the first agentNumber
+	// slots (filled by spawnAgents) start alive and aged 0
+	void resetPopulation()
+	{
+		std::vector<std::string> layout = agentLayout();
+		if (!scanBlocksShader || populationLayout != layout)
+		{
+			auto withLayout = [&layout](const char *pass) { std::vector<std::string> defines = layout; defines.push_back(pass); return defines; };
+			scanBlocksShader = std::make_unique<computeShader>("shaders/population.comp", withLayout("SCAN_BLOCKS"));
+			scanTotalsShader = std::make_unique<computeShader>("shaders/population.comp", withLayout("SCAN_TOTALS"));
+			scatterShader = std::make_unique<computeShader>("shaders/population.comp", withLayout("SCATTER"));
+			populationLayout = layout;
+		}
+
+		if (populationSSBO == 0)
+		{
+			glGenBuffers(1, &populationSSBO);
+			glGenBuffers(1, &lifeSSBO);
+			glGenBuffers(1, &spareLifeSSBO);
+			glGenBuffers(1, &spareAgentSSBO);
+			glGenBuffers(1, &aliveSSBO);
+			glGenBuffers(1, &offsetSSBO);
+			glGenBuffers(1, &blockSumSSBO);
+		}
+
+		// agent pass dispatch size, live count and survivors
+		unsigned int population[5] = {(agentNumber + 63) / 64, 1, 1, agentNumber, agentNumber};
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, populationSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(population), population, GL_DYNAMIC_DRAW);
+
+		// age and starved steps per agent
+		std::vector<unsigned int> zeros((size_t)agentCapacity * 2, 0);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, lifeSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, zeros.size() * sizeof(unsigned int), zeros.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, spareLifeSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, zeros.size() * sizeof(unsigned int), NULL, GL_DYNAMIC_DRAW);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, spareAgentSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, agentCapacity * agentBytes(), NULL, GL_DYNAMIC_DRAW);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, aliveSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)agentCapacity * sizeof(unsigned int), zeros.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, offsetSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, (size_t)agentCapacity * sizeof(unsigned int), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, blockSumSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, populationBlocks() * sizeof(unsigned int), NULL, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	};
+
+	unsigned int populationBlocks()
+	{
+		return (agentCapacity + scanBlock - 1) / scanBlock;
+	};
+
+	// reduction passes and buffers of the per step metrics
+	std::unique_ptr<computeShader> metricTrailShader;
+	std::unique_ptr<computeShader> metricTotalsShader;
+	std::unique_ptr<computeShader> metricAgentShader;
+	std::vector<std::string> metricsLayout;
+
+	// one partial sum per 16x16 workgroup of metricTrailShader
+	unsigned int metricGroupsX()
+	{
+		return (width + 15) / 16;
+	};
+
+	unsigned int metricGroupsY()
+	{
+		return (height + 15) / 16;
+	};
+
+	// closes the last run's csv, then opens a new one and zeroes the metrics
+	// buffer if the preset asks for it
+	void resetMetrics(const json &preset)
+	{
+		metrics.finish();
+		if (!measuring)
+			return;
+
+		metrics = stepMetrics(preset["metricsOutput"], preset.value("metricsEvery", 60), preset.value("metricsRing", 3));
+
+		std::vector<std::string> layout = agentLayout();
+		if (dynamic)
+			layout.push_back("POPULATION");
+
+		if (!metricTrailShader || metricsLayout != layout)
+		{
+			auto withLayout = [&layout](const char *pass) { std::vector<std::string> defines = layout; defines.push_back(pass); return defines; };
+			metricTrailShader = std::make_unique<computeShader>("shaders/metrics.comp", withLayout("TRAIL_SUMS"));
+			metricTotalsShader = std::make_unique<computeShader>("shaders/metrics.comp", withLayout("TOTALS"));
+			metricAgentShader = std::make_unique<computeShader>("shaders/metrics.comp", withLayout("AGENTS"));
+			metricsLayout = layout;
+		}
+
+		if (metricsSSBO == 0)
+		{
+			glCreateBuffers(1, &metricsSSBO);
+			glCreateBuffers(1, &metricPartialSSBO);
+		}
+
+		metricsBlock zeros = {};
+		glNamedBufferData(metricsSSBO, sizeof(zeros), &zeros, GL_DYNAMIC_COPY);
+		glNamedBufferData(metricPartialSSBO, (size_t)metricGroupsX() * metricGroupsY() * 2 * sizeof(unsigned int), NULL, GL_DYNAMIC_COPY);
+	};
+
+	// empties the tile flags and the active list for a cleared trail
+	void resetTiles()
+	{
+		if (!activeTileShader)
+			activeTileShader = std::make_unique<computeShader>("shaders/activeTiles.comp");
+
+		tilesX = (width + 7) / 8;
+		tilesY = (height + 7) / 8;
+		size_t tiles = (size_t)tilesX * tilesY;
+
+		if (tileFlagSSBO == 0)
+		{
+			glGenBuffers(1, &tileFlagSSBO);
+			glGenBuffers(1, &tileHistorySSBO);
+			glGenBuffers(1, &activeTileBuffer);
+		}
+
+		// trail + deposit flag per tile
+		std::vector<unsigned int> zeros(tiles * 2, 0);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileFlagSSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, zeros.size() * sizeof(unsigned int), zeros.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileHistorySSBO);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, tiles * sizeof(unsigned int), zeros.data(), GL_DYNAMIC_DRAW);
+
+		// dispatch (0, 1, 1) followed by room for every tile
+		std::vector<unsigned int> active(3 + tiles, 0);
+		active[1] = 1;
+		active[2] = 1;
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, activeTileBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, active.size() * sizeof(unsigned int), active.data(), GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	};
+
+	// helper programs the loaded modes run and what they are built from,
+	// has to match how reset*() builds them
+	std::vector<std::pair<computeShader*, shaderSource>> helperPrograms()
+	{
+		auto withLayout = [](const std::vector<std::string> &layout, const char *pass) { std::vector<std::string> defines = layout; defines.push_back(pass); return defines; };
+
+		std::vector<std::pair<computeShader*, shaderSource>> helpers;
+		if (sparse)
+			helpers.push_back({activeTileShader.get(), {"", "", "shaders/activeTiles.comp", {}}});
+		if (dynamic)
+		{
+			helpers.push_back({scanBlocksShader.get(), {"", "", "shaders/population.comp", withLayout(populationLayout, "SCAN_BLOCKS")}});
+			helpers.push_back({scanTotalsShader.get(), {"", "", "shaders/population.comp", withLayout(populationLayout, "SCAN_TOTALS")}});
+			helpers.push_back({scatterShader.get(), {"", "", "shaders/population.comp", withLayout(populationLayout, "SCATTER")}});
+		}
+		if (mip)
+			helpers.push_back({pyramidShader.get(), {"", "", "shaders/pyramid.comp", {}}});
+		if (sat)
+		{
+			helpers.push_back({senseRowShader.get(), {"", "", "shaders/sat.comp", {"ROWS"}}});
+			helpers.push_back({senseColumnShader.get(), {"", "", "shaders/sat.comp", {"COLUMNS"}}});
+		}
+		if (measuring)
+		{
+			helpers.push_back({metricTrailShader.get(), {"", "", "shaders/metrics.comp", withLayout(metricsLayout, "TRAIL_SUMS")}});
+			helpers.push_back({metricTotalsShader.get(), {"", "", "shaders/metrics.comp", withLayout(metricsLayout, "TOTALS")}});
+			helpers.push_back({metricAgentShader.get(), {"", "", "shaders/metrics.comp", withLayout(metricsLayout, "AGENTS")}});
+		}
+		return helpers;
+	};
+
+	// shaders the passes run, set by step() and display()
+	computeShader *diffuseProgram = nullptr;
+	computeShader *agentProgram = nullptr;
+	vertFragShader *displayProgram = nullptr;
+	int displayWidth = 0;
+	int displayHeight = 0;
+
+	std::vector<int> stepPasses;
+	int displayPass = -1;
+
+	// pyramid levels the sensor box size needs, sensors read level
+	// log2(box size) - 1 and the one above it
+	int pyramidLevelsUsed()
+	{
+		if (settings.sensorSize <= 0)
+			return 0;
+
+		double lod = std::log2(2.0 * settings.sensorSize + 1.0) - 1.0;
+		return std::min(pyramidLevels, (int)std::floor(lod) + 2);
+	};
+
+	// the passes of a step in order, then the display pass, each with the
+	// resources it reads and writes, the graph puts the barriers in between
+	void buildPasses()
+	{
+		auto trail = [this]() { return trailTextures[currentTrail]; };
+		auto nextTrail = [this]() { return trailTextures[1 - currentTrail]; };
+		auto deposits = glObject(depositTexture);
+		auto settingsBuffer = glObject(settingsSSBO);
+		auto agents = glObject(agentDataSSBO);
+
+		stepPasses.clear();
+
+
+		// blur + decay the trail (the active tiles of it) into the other texture
+		// ----------------------------------------------------------------------
+		std::vector<passAccess> diffusion = {
+			imageAccess(1, trail, GL_RGBA32F, true, false),
+			imageAccess(2, deposits, GL_R32UI, true, false),
+			imageAccess(5, nextTrail, GL_RGBA32F, false, true),
+			storageAccess(3, settingsBuffer, true, false)};
+
+		if (sparse)
+		{
+			diffusion.push_back(storageAccess(10, glObject(tileFlagSSBO), true, true));
+			diffusion.push_back(storageAccess(12, glObject(activeTileBuffer), true, false));
+			diffusion.push_back(indirectAccess(glObject(activeTileBuffer)));
+		}
+
+		stepPasses.push_back(passes.add("diffuse", diffusion, [this]()
+		{
+			diffuseProgram->use();
+
+			// one 8x8 workgroup per active tile, the count was written on the GPU
+			if (sparse)
+				glDispatchComputeIndirect(0);
+			else // has to match the 8x8 local size in diffuse.comp
+				diffuseProgram->dispatch((width + 7) / 8, (height + 7) / 8);
+		}));
+
+		// deposits are folded into the new trail now, clear them for the agents,
+		// the new trail is the current one for every pass after this
+		stepPasses.push_back(passes.add("clear deposits", {textureUpdate(deposits, true)}, [this]()
+		{
+			glClearTexImage(depositTexture, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &depositClear);
+			currentTrail = 1 - currentTrail;
+		}));
+
+
+		// reduces the current trail into the pyramid levels the sensor box
+		// size needs, each level is one pass over a quarter of the one before
+		// ----------------------------------------------------------------------
+		for (int level = 0; mip && level < pyramidLevels; level++)
+		{
+			std::vector<passAccess> reduction = {
+				storageAccess(3, settingsBuffer, true, false),
+				imageAccess(1, trail, GL_RGBA32F, true, false),
+				imageAccess(7, glObject(pyramidTexture), GL_R32F, false, true, level)};
+			if (level > 0)
+				reduction.push_back(imageAccess(6, glObject(pyramidTexture), GL_R32F, true, false, level - 1));
+
+			stepPasses.push_back(passes.add("pyramid level " + std::to_string(level), reduction, [this, level]()
+			{
+				if (level == 0)
+					glTextureParameteri(pyramidTexture, GL_TEXTURE_MAX_LEVEL, pyramidLevelsUsed() - 1);
+
+				pyramidShader->use();
+				pyramidShader->setBool("fromTrail", level == 0);
+
+				// has to match the 8x8 local size in pyramid.comp
+				int levelWidth = std::max(1, (int)(width / 2) >> level);
+				int levelHeight = std::max(1, (int)(height / 2) >> level);
+				pyramidShader->dispatch((levelWidth + 7) / 8, (levelHeight + 7) / 8);
+			}, [this, level]() { return level < pyramidLevelsUsed(); }));
+		}
+
+
+		// prefix sums the current trail along every row, then down every column,
+		// one workgroup per row or column
+		// ----------------------------------------------------------------------
+		if (sat)
+		{
+			std::vector<passAccess> prefixSums = {
+				storageAccess(3, settingsBuffer, true, false),
+				imageAccess(1, trail, GL_RGBA32F, true, false),
+				imageAccess(6, glObject(senseTableTexture), GL_R32UI, true, true)};
+
+			stepPasses.push_back(passes.add("sense table rows", prefixSums, [this]()
+			{
+				senseRowShader->use();
+				senseRowShader->dispatch(height, 1);
+			}));
+			stepPasses.push_back(passes.add("sense table columns", prefixSums, [this]()
+			{
+				senseColumnShader->use();
+				senseColumnShader->dispatch(width, 1);
+			}));
+		}
+
+
+		// calculate new simulation step in compute shader
+		// ---------------------------------
+		std::vector<passAccess> movement = {
+			imageAccess(1, trail, GL_RGBA32F, true, false),
+			imageAccess(2, deposits, GL_R32UI, true, true),
+			storageAccess(3, settingsBuffer, true, false),
+			storageAccess(4, agents, true, true)};
+
+		if (mip)
+			movement.push_back(samplerAccess(0, glObject(pyramidTexture)));
+
+		if (sat)
+			movement.push_back(imageAccess(6, glObject(senseTableTexture), GL_R32UI, true, false));
+
+		// agents flag the tiles they deposit in
+		if (sparse)
+			movement.push_back(storageAccess(10, glObject(tileFlagSSBO), true, true));
+
+		// agents count their edge resets
+		if (measuring)
+			movement.push_back(storageAccess(20, glObject(metricsSSBO), true, true));
+
+		if (dynamic)
+		{
+			movement.push_back(storageAccess(13, glObject(populationSSBO), true, false));
+			movement.push_back(storageAccess(14, glObject(lifeSSBO), true, true));
+			movement.push_back(storageAccess(15, glObject(aliveSSBO), false, true));
+			movement.push_back(indirectAccess(glObject(populationSSBO)));
+		}
+
+		stepPasses.push_back(passes.add("agents", movement, [this]()
+		{
+			computeShader &agentShader = *agentProgram;
+			agentShader.use();
+
+			agentShader.setUint("frame", frameIndex++);
+			agentShader.setUint("seed", seed);
+
+			if (vectorHeading)
+				agentShader.setVec2("sensorRotor", std::cos(settings.sensorAngle), std::sin(settings.sensorAngle));
+
+			if (dynamic)
+			{
+				// sized to the live agents by the last compaction
+				setPopulationUniforms(agentShader);
+				glDispatchComputeIndirect(0);
+			}
+			else
+			{
+				//TODO: figure out how to calculate most optimal computeDivisor depending on AGENT_NUM
+				// has to match local_size_x in the compute shader, the result doesn't depend on it
+				const int computeDivisor = 64;
+
+				// round up so the last partial workgroup still runs
+				agentShader.dispatch((agentNumber + computeDivisor - 1) / computeDivisor, 1);
+			}
+		}));
+
+
+		// builds next step's active list from this step's flags, then clears them
+		// ----------------------------------------------------------------------
+		if (sparse)
+		{
+			std::vector<passAccess> listing = {
+				bufferUpdate(glObject(activeTileBuffer), true),
+				storageAccess(3, settingsBuffer, true, false),
+				storageAccess(10, glObject(tileFlagSSBO), true, false),
+				storageAccess(11, glObject(tileHistorySSBO), true, true),
+				storageAccess(12, glObject(activeTileBuffer), true, true)};
+
+			stepPasses.push_back(passes.add("active tiles", listing, [this]()
+			{
+				unsigned int zero = 0;
+				glClearNamedBufferSubData(activeTileBuffer, GL_R32UI, 0, sizeof(zero), GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+				// has to match local_size_x in activeTiles.comp
+				activeTileShader->use();
+				activeTileShader->dispatch((tilesX * tilesY + 63) / 64, 1);
+			}));
+
+			stepPasses.push_back(passes.add("clear tile flags", {bufferUpdate(glObject(tileFlagSSBO), true)}, [this]()
+			{
+				unsigned int zero = 0;
+				glClearNamedBufferData(tileFlagSSBO, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+			}));
+		}
+
+
+		// compacts the agents that survived this step and spawns up to the target
+		// ----------------------------------------------------------------------
+		if (dynamic)
+		{
+			stepPasses.push_back(passes.add("scan blocks", {
+				storageAccess(3, settingsBuffer, true, false),
+				storageAccess(13, glObject(populationSSBO), true, false),
+				storageAccess(15, glObject(aliveSSBO), true, true),
+				storageAccess(16, glObject(offsetSSBO), false, true),
+				storageAccess(17, glObject(blockSumSSBO), false, true)}, [this]()
+			{
+				scanBlocksShader->use();
+				scanBlocksShader->dispatch(populationBlocks(), 1);
+			}));
+
+			stepPasses.push_back(passes.add("scan totals", {
+				storageAccess(3, settingsBuffer, true, false),
+				storageAccess(4, agents, true, false),
+				storageAccess(13, glObject(populationSSBO), true, true),
+				storageAccess(17, glObject(blockSumSSBO), true, true)}, [this]()
+			{
+				scanTotalsShader->use();
+				setPopulationUniforms(*scanTotalsShader);
+				scanTotalsShader->dispatch(1, 1);
+			}));
+
+			stepPasses.push_back(passes.add("scatter", {
+				storageAccess(3, settingsBuffer, true, false),
+				storageAccess(4, agents, true, false),
+				storageAccess(13, glObject(populationSSBO), true, false),
+				storageAccess(14, glObject(lifeSSBO), true, false),
+				storageAccess(15, glObject(aliveSSBO), true, false),
+				storageAccess(16, glObject(offsetSSBO), true, false),
+				storageAccess(17, glObject(blockSumSSBO), true, false),
+				storageAccess(18, glObject(spareAgentSSBO), false, true),
+				storageAccess(19, glObject(spareLifeSSBO), false, true)}, [this]()
+			{
+				scatterShader->use();
+				scatterShader->setUint("frame", frameIndex);
+				scatterShader->setUint("seed", seed);
+				scatterShader->setInt("spawnMethod", spawnMethod);
+				scatterShader->dispatch(populationBlocks(), 1);
+
+				std::swap(agentDataSSBO, spareAgentSSBO);
+				std::swap(lifeSSBO, spareLifeSSBO);
+			}));
+		}
+
+
+		// reduces the trail and agents of steps the metrics are logged for,
+		// then hands the result to the readback ring and zeroes the counters
+		// ----------------------------------------------------------------------
+		if (measuring)
+		{
+			auto logged = [this]() { return metrics.due(frameIndex); };
+			auto metricsBuffer = glObject(metricsSSBO);
+
+			stepPasses.push_back(passes.add("metrics trail", {
+				storageAccess(3, settingsBuffer, true, false),
+				imageAccess(1, trail, GL_RGBA32F, true, false),
+				storageAccess(21, glObject(metricPartialSSBO), false, true)}, [this]()
+			{
+				metricTrailShader->use();
+				metricTrailShader->dispatch(metricGroupsX(), metricGroupsY());
+			}, logged));
+
+			stepPasses.push_back(passes.add("metrics totals", {
+				storageAccess(20, metricsBuffer, true, true),
+				storageAccess(21, glObject(metricPartialSSBO), true, false)}, [this]()
+			{
+				metricTotalsShader->use();
+				metricTotalsShader->dispatch(1, 1);
+			}, logged));
+
+			std::vector<passAccess> histograms = {
+				storageAccess(3, settingsBuffer, true, false),
+				storageAccess(4, agents, true, false),
+				storageAccess(20, metricsBuffer, true, true)};
+			if (dynamic)
+			{
+				histograms.push_back(storageAccess(13, glObject(populationSSBO), true, false));
+				histograms.push_back(indirectAccess(glObject(populationSSBO)));
+			}
+
+			stepPasses.push_back(passes.add("metrics agents", histograms, [this]()
+			{
+				metricAgentShader->use();
+
+				// the live agents, in the agent pass' workgroups
+				if (dynamic)
+				{
+					glDispatchComputeIndirect(0);
+				}
+				else
+				{
+					metricAgentShader->setUint("agentCount", agentNumber);
+					metricAgentShader->dispatch((agentNumber + 63) / 64, 1);
+				}
+			}, logged));
+
+			stepPasses.push_back(passes.add("metrics readback", {bufferUpdate(metricsBuffer, true)}, [this]()
+			{
+				metrics.queue(metricsSSBO, frameIndex, width * height);
+
+				unsigned int zero = 0;
+				glClearNamedBufferData(metricsSSBO, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+			}, logged));
+		}
+
+
+		// draws the trail and deposits into the bound framebuffer
+		// ----------------------------------------------------------------------
+		displayPass = passes.add("display", {
+			imageAccess(1, trail, GL_RGBA32F, true, false),
+			imageAccess(2, deposits, GL_R32UI, true, false),
+			storageAccess(3, settingsBuffer, true, false)}, [this]()
+		{
+			displayProgram->use();
+			displayProgram->setVec2("mapScale", (float)width / std::max(1, displayWidth), (float)height / std::max(1, displayHeight));
+
+			glBindVertexArray(VAO);
+			glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+		});
+	};
+
+	void createTextures(unsigned int newWidth, unsigned int newHeight)
+	{
+		if (depositTexture != 0)
+		{
+			glDeleteTextures(2, trailTextures);
+			glDeleteTextures(1, &depositTexture);
+		}
+
+		width = newWidth;
+		height = newHeight;
+
+		// generate empty trail and deposit textures and all params for it
+		// ---------------------------------------------------------------
+		glGenTextures(2, trailTextures);
+		glGenTextures(1, &depositTexture);
+
+		// trail textures setup
+		for (int i = 0; i < 2; i++)
+		{
+			glBindTexture(GL_TEXTURE_2D, trailTextures[i]);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		}
+
+		// deposit texture setup, counts how many agents deposited on each pixel
+		// this step, adding counts is order independent unlike adding floats
+		glBindTexture(GL_TEXTURE_2D, depositTexture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, width, height, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+		glBindTexture(GL_TEXTURE_2D, 0);
+	};
+
+	// bytes per agent in the agent buffer
+	size_t agentBytes() const
+	{
+		if (packing)
+			return sizeof(packedAgent);
+		return vectorHeading ? sizeof(headingAgent) : sizeof(agent);
+	};
+
+	void spawnAgents(const json &preset)
+	{
+		// create agent struct and fill an array with agents
+		// -------------------------------------------------
+		agentNumber = preset["agentNumber"];
+		seed = presetSeed(preset);
+
+		// a dynamic population gets room to grow up to its target or maxAgents
+		agentCapacity = agentNumber;
+		if (dynamic)
+			agentCapacity = preset.value("maxAgents", std::max(agentNumber, targetAgents));
+		agentCapacity = std::max(agentCapacity, agentNumber);
+
+		// !!danger zone, be careful with malloc and free it at the end
+		// this is needed for bigger amount of agents that exceeds the max size
+		// of default arrays in c++
+
+		agent *agentsArrPtr;
+		agentsArrPtr = (agent*) malloc(agentNumber * sizeof(agent));
+
+		createAgents(preset, width, height, seed, agentsArrPtr);
+
+		// same agents with their angle turned into a heading vector
+		std::vector<headingAgent> headingAgents;
+		if (vectorHeading)
+		{
+			headingAgents.resize(agentNumber);
+			for (unsigned int i = 0; i < agentNumber; i++)
+				headingAgents[i] = {agentsArrPtr[i].x, agentsArrPtr[i].y, std::cos(agentsArrPtr[i].angle), std::sin(agentsArrPtr[i].angle)};
+		}
+
+		// or packed into 8 bytes
+		std::vector<packedAgent> packedData;
+		if (packing)
+		{
+			packedData.resize(agentNumber);
+			for (unsigned int i = 0; i < agentNumber; i++)
+				packedData[i] = packAgent(agentsArrPtr[i]);
+		}
+
+		// create and fill SSBO with agent array created above, an existing
+		// buffer of the same size is overwritten instead of reallocated
+		// -----------------------------------------------------------------
+		if (agentDataSSBO == 0)
+			glGenBuffers(1, &agentDataSSBO);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, agentDataSSBO);
+		if (allocatedAgentBytes != agentCapacity * agentBytes())
+		{
+			allocatedAgentBytes = agentCapacity * agentBytes();
+			glBufferData(GL_SHADER_STORAGE_BUFFER, allocatedAgentBytes, NULL, GL_DYNAMIC_READ);
+		}
+		if (packing)
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, agentNumber * agentBytes(), packedData.data());
+		else if (vectorHeading)
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, agentNumber * agentBytes(), headingAgents.data());
+		else
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, agentNumber * agentBytes(), agentsArrPtr);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		// ooga booga free memory to make pc no crash
+		free(agentsArrPtr);
+	};
+};
+#endif
@@ -0,0 +1,260 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+#include "json.hpp"
+using json = nlohmann::json;
+
+#include "shader.h"
+#include "simulation.h"
+#include "batch.h"
+#include "imageWrite.h"
+
+
+class parameterSweep
+{
+	// runs a base preset once for every combination of the swept parameters
+	// ---------------------------------------------------------------------
+	// every run reuses the GL context, the compiled shaders and (when the map
+	// size and agent count match) the textures and buffers of the run before,
+	// it writes one metrics row and one .ppm thumbnail per run
+	// with "batch": K up to K runs of the same map size are stepped together
+public:
+	parameterSweep(const json &sweepSettings, const json &basePreset)
+	{
+		base = basePreset;
+		steps = sweepSettings.value("steps", 500);
+		outputDir = sweepSettings.value("output", "sweeps/output");
+		thumbnailWidth = sweepSettings.value("thumbnailWidth", 160);
+		batchSize = sweepSettings.value("batch", 1);
+
+		// every parameter is either a list of values or a {from, to, count} range,
+		// the runs are all combinations of them (a grid)
+		for (auto &item : sweepSettings["parameters"].items())
+		{
+			std::vector<json> values;
+
+			if (item.value().is_array())
+			{
+				for (const json &value : item.value())
+					values.push_back(value);
+			}
+			else if (item.value().is_object())
+			{
+				double from = item.value()["from"];
+				double to = item.value()["to"];
+				int count = item.value().value("count", 2);
+
+				for (int i = 0; i < count; i++)
+					values.push_back(count == 1 ? from : from + (to - from) * i / (count - 1));
+			}
+			else
+			{
+				values.push_back(item.value());
+			}
+
+			names.push_back(item.key());
+			grid.push_back(values);
+		}
+	};
+
+	int run(slimeSimulation &sim, computeShader &diffuseShader, computeShader &agentShader)
+	{
+		std::filesystem::create_directories(outputDir);
+
+		std::ofstream csv(outputDir + "/metrics.csv");
+		if (!csv)
+		{
+			std::cout << "Couldn't write into sweep output directory: " << outputDir << std::endl;
+			return -1;
+		}
+
+		csv << "run";
+		for (const std::string &name : names)
+			csv << "," << name;
+		csv << ",steps,msPerStep,trailMass,coverage,meanIntensity,stdIntensity,maxIntensity\n";
+
+		size_t runCount = 1;
+		for (const std::vector<json> &values : grid)
+			runCount *= values.size();
+
+		std::vector<json> presets;
+		for (size_t run = 0; run < runCount; run++)
+		{
+			// pick this run's value of every parameter (mixed radix index)
+			json preset = base;
+			size_t index = run;
+			for (size_t p = 0; p < names.size(); p++)
+			{
+				preset[names[p]] = grid[p][index % grid[p].size()];
+				index /= grid[p].size();
+			}
+			presets.push_back(preset);
+		}
+
+		// every run steps the shaders compiled for the base preset, runs can't
+		// pick other shader variants or turn modes of the map on or off
+		auto modes = [](const json &preset) {
+			return std::vector<bool>{sparseTiles(preset), dynamicPopulation(preset), mipSensing(preset), satSensing(preset),
+				headingVectors(preset), packedAgents(preset), measuredMetrics(preset)};
+		};
+		for (const json &preset : presets)
+		{
+			if (preset["simulationShader"] != base["simulationShader"] || modes(preset) != modes(base))
+			{
+				std::cout << "Sweep runs can't change the simulation shader, sparse tiles, population, sensing, heading, agent format or metrics, set them in the base preset." << std::endl;
+				return -1;
+			}
+		}
+
+		// batching needs the BATCHED variants of the final shaders
+		if (batchSize > 1 && base["simulationShader"] != "stageFinal")
+		{
+			std::cout << "Sweep batching only works with the stageFinal simulation shader, running one at a time." << std::endl;
+			batchSize = 1;
+		}
+
+		// the batched shaders have none of the single map's modes
+		if (batchSize > 1 && (dynamicPopulation(base) || mipSensing(base) || satSensing(base)
+			|| headingVectors(base) || packedAgents(base) || measuredMetrics(base)))
+		{
+			std::cout << "Sweep batching doesn't work with dynamic populations, mip or table sensing, heading vectors, packed agents or metrics, running one at a time." << std::endl;
+			batchSize = 1;
+		}
+
+		computeShader batchDiffuseShader = computeShader("shaders/diffuse.comp", {"BATCHED"});
+		computeShader batchAgentShader = computeShader("shaders/slimeFinal.comp", {"BATCHED"});
+		slimeBatch batch;
+
+		size_t run = 0;
+		while (run < runCount)
+		{
+			// runs next to each other with the same map size go into one batch
+			size_t count = 1;
+			while (count < (size_t)batchSize && run + count < runCount
+				&& presets[run + count]["mapWidth"] == presets[run]["mapWidth"]
+				&& presets[run + count]["mapHeight"] == presets[run]["mapHeight"])
+			{
+				count++;
+			}
+
+			if (count == 1)
+			{
+				// the shaders were built for the base preset's sparse setting
+				json preset = presets[run];
+				preset["sparseTiles"] = sparseTiles(base);
+				sim.load(preset);
+
+				glFinish();
+				auto start = std::chrono::steady_clock::now();
+
+				for (int i = 0; i < steps; i++)
+					sim.step(diffuseShader, agentShader);
+
+				glFinish();
+				double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+				sim.readTrail(pixels);
+				record(csv, run, runCount, presets[run], milliseconds, sim.width, sim.height);
+			}
+			else
+			{
+				std::vector<json> batchPresets(presets.begin() + run, presets.begin() + run + count);
+				batch.load(batchPresets);
+
+				glFinish();
+				auto start = std::chrono::steady_clock::now();
+
+				for (int i = 0; i < steps; i++)
+					batch.step(batchDiffuseShader, batchAgentShader);
+
+				glFinish();
+				double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+				// time per run is the batch's time shared between its runs
+				for (size_t layer = 0; layer < count; layer++)
+				{
+					batch.readTrail(layer, pixels);
+					record(csv, run + layer, runCount, presets[run + layer], milliseconds / count, batch.width, batch.height);
+				}
+			}
+
+			run += count;
+		}
+
+
+		return 0;
+	};
+
+private:
+	json base;
+	int steps;
+	std::string outputDir;
+	int thumbnailWidth;
+	int batchSize;
+
+	std::vector<float> pixels;
+	std::vector<unsigned char> thumbnail;
+
+	std::vector<std::string> names;
+	std::vector<std::vector<json>> grid;
+
+	// writes the metrics row and thumbnail of a finished run from its trail in pixels
+	void record(std::ofstream &csv, size_t run, size_t runCount, const json &preset, double milliseconds, int width, int height)
+	{
+		std::vector<double> metrics = trailMetrics(pixels);
+
+		int thumbHeight;
+		makeThumbnail(pixels, width, height, thumbnailWidth, thumbnail, thumbHeight);
+
+		char fileName[32];
+		snprintf(fileName, sizeof(fileName), "/run_%04zu.ppm", run);
+		writePPM(outputDir + fileName, std::min(thumbnailWidth, width), thumbHeight, thumbnail);
+
+		csv << run;
+		for (const std::string &name : names)
+			csv << "," << preset[name].dump();
+		csv << "," << steps << "," << milliseconds / std::max(1, steps);
+		for (double metric : metrics)
+			csv << "," << metric;
+		csv << "\n";
+		csv.flush();
+
+		std::cout << "sweep run " << run + 1 << "/" << runCount << ": " << milliseconds / std::max(1, steps) << " ms/step\n";
+	};
+
+	// trail mass, fraction of covered pixels, mean, standard deviation and max
+	// of the per pixel intensity (average of the rgb channels)
+	static std::vector<double> trailMetrics(const std::vector<float> &rgba)
+	{
+		size_t count = rgba.size() / 4;
+		double sum = 0, sumSquares = 0, maximum = 0;
+		size_t covered = 0;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			double intensity = (rgba[i * 4 + 0] + rgba[i * 4 + 1] + rgba[i * 4 + 2]) / 3.0;
+			sum += intensity;
+			sumSquares += intensity * intensity;
+			maximum = std::max(maximum, intensity);
+			if (intensity > 0.01)
+				covered++;
+		}
+
+		double mean = sum / std::max<size_t>(1, count);
+		double variance = std::max(0.0, sumSquares / std::max<size_t>(1, count) - mean * mean);
+
+		return {sum, (double)covered / std::max<size_t>(1, count), mean, std::sqrt(variance), maximum};
+	};
+};
+#endif
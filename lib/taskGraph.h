@@ -0,0 +1,188 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <functional>
+
+#include "threadPool.h"
+
+class stealingDeque
+{
+	// ready tasks of one worker
+	// -------------------------
+	// a Chase-Lev deque without locks: the owner pushes and takes at the
+	// bottom (newest first, their inputs are likely still in its cache),
+	// other workers steal from the top (oldest first), only the last task
+	// is contended and a compare and swap on top settles who gets it
+	// it never grows, capacity has to cover every task pushed between resets
+public:
+	static const int empty = -1;
+
+	void reset(size_t capacity)
+	{
+		size_t size = 1;
+		while (size < capacity)
+			size *= 2;
+
+		tasks.reset(new std::atomic<int>[size]);
+		mask = (long long)size - 1;
+		top.store(0, std::memory_order_relaxed);
+		bottom.store(0, std::memory_order_relaxed);
+	};
+
+	// owner only
+	void push(int task)
+	{
+		long long last = bottom.load(std::memory_order_relaxed);
+		tasks[last & mask].store(task, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		bottom.store(last + 1, std::memory_order_relaxed);
+	};
+
+	// owner only, empty when there's nothing left
+	int take()
+	{
+		long long last = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(last, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long first = top.load(std::memory_order_relaxed);
+
+		if (first > last)
+		{
+			bottom.store(last + 1, std::memory_order_relaxed);
+			return empty;
+		}
+
+		int task = tasks[last & mask].load(std::memory_order_relaxed);
+		if (first == last)
+		{
+			// the last task, a thief may be after it too
+			if (!top.compare_exchange_strong(first, first + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+				task = empty;
+			bottom.store(last + 1, std::memory_order_relaxed);
+		}
+		return task;
+	};
+
+	// any worker, empty when there's nothing left or another worker won
+	int steal()
+	{
+		long long first = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		long long last = bottom.load(std::memory_order_acquire);
+
+		if (first >= last)
+			return empty;
+
+		int task = tasks[first & mask].load(std::memory_order_relaxed);
+		if (!top.compare_exchange_strong(first, first + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			return empty;
+		return task;
+	};
+
+private:
+	// top and bottom on their own cache lines, thieves hammer top
+	alignas(64) std::atomic<long long> top{0};
+	alignas(64) std::atomic<long long> bottom{0};
+	std::unique_ptr<std::atomic<int>[]> tasks;
+	long long mask = 0;
+};
+
+class taskGraph
+{
+	// tasks and what they wait for, run by work stealing
+	// --------------------------------------------------
+	// a task becomes ready the moment its last input finished, the worker
+	// that finished it pushes it onto its own deque and usually runs it next,
+	// workers without ready tasks steal from the others, so there is no
+	// barrier anywhere in the graph, e.g. between the steps it spans
+	// the whole graph is one threadPool::run(), idle workers spin (yielding)
+	// until every task ran
+public:
+	// adds a task, work(worker) runs it, returns its index
+	int add(std::function<void(int)> work)
+	{
+		tasks.push_back(std::make_unique<task>());
+		tasks.back()->work = std::move(work);
+		return (int)tasks.size() - 1;
+	};
+
+	// task doesn't start before input finished
+	void depend(int taskIndex, int input)
+	{
+		tasks[input]->successors.push_back(taskIndex);
+		tasks[taskIndex]->inputs++;
+	};
+
+	size_t size() const
+	{
+		return tasks.size();
+	};
+
+	void clear()
+	{
+		tasks.clear();
+	};
+
+	void run(threadPool &pool)
+	{
+		int workers = pool.size();
+		if (deques.size() != (size_t)workers)
+			deques = std::vector<stealingDeque>(workers);
+		for (stealingDeque &deque : deques)
+			deque.reset(tasks.size());
+
+		// tasks without inputs are dealt out before anyone starts
+		int next = 0;
+		for (size_t index = 0; index < tasks.size(); index++)
+		{
+			tasks[index]->waiting.store(tasks[index]->inputs, std::memory_order_relaxed);
+			if (tasks[index]->inputs == 0)
+				deques[next++ % workers].push((int)index);
+		}
+		remaining.store((int)tasks.size(), std::memory_order_relaxed);
+
+		pool.run([this, workers](int worker)
+		{
+			stealingDeque &own = deques[worker];
+
+			while (remaining.load(std::memory_order_acquire) > 0)
+			{
+				int index = own.take();
+				for (int offset = 1; index == stealingDeque::empty && offset < workers; offset++)
+					index = deques[(worker + offset) % workers].steal();
+
+				if (index == stealingDeque::empty)
+				{
+					std::this_thread::yield();
+					continue;
+				}
+
+				task &current = *tasks[index];
+				current.work(worker);
+
+				for (int successor : current.successors)
+					if (tasks[successor]->waiting.fetch_sub(1, std::memory_order_acq_rel) == 1)
+						own.push(successor);
+
+				remaining.fetch_sub(1, std::memory_order_acq_rel);
+			}
+		});
+	};
+
+private:
+	struct task {
+		std::function<void(int)> work;
+		std::vector<int> successors;
+		int inputs = 0;
+		std::atomic<int> waiting{0};
+	};
+
+	std::vector<std::unique_ptr<task>> tasks;
+	std::vector<stealingDeque> deques;
+	std::atomic<int> remaining{0};
+};
+#endif
@@ -0,0 +1,106 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+class threadPool
+{
+	// fixed set of worker threads for the CPU simulation
+	// --------------------------------------------------
+	// run() hands the same task to every worker (the calling thread is worker
+	// 0) and returns once all of them finished it, workers sleep in between,
+	// so a step costs two wake ups per thread instead of creating threads
+	// tasks split their work by worker index, e.g. one band of rows each
+public:
+	threadPool(int threads)
+	{
+		if (threads <= 0)
+			threads = std::max(1u, std::thread::hardware_concurrency());
+
+		workerCount = threads;
+		for (int worker = 1; worker < workerCount; worker++)
+			workers.emplace_back([this, worker]() { work(worker); });
+	};
+
+	~threadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_all();
+
+		for (std::thread &worker : workers)
+			worker.join();
+	};
+
+	threadPool(const threadPool&) = delete;
+	threadPool& operator=(const threadPool&) = delete;
+
+	int size() const
+	{
+		return workerCount;
+	};
+
+	// task(worker) on every worker, returns when all of them returned
+	void run(const std::function<void(int)> &task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			current = &task;
+			remaining = workerCount - 1;
+			generation++;
+		}
+		wake.notify_all();
+
+		task(0);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [this]() { return remaining == 0; });
+		current = nullptr;
+	};
+
+private:
+	int workerCount;
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable finished;
+
+	const std::function<void(int)> *current = nullptr;
+	unsigned long long generation = 0;
+	int remaining = 0;
+	bool stopping = false;
+
+	void work(int worker)
+	{
+		unsigned long long seen = 0;
+
+		while (true)
+		{
+			const std::function<void(int)> *task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&]() { return stopping || generation != seen; });
+				if (stopping)
+					return;
+
+				seen = generation;
+				task = current;
+			}
+
+			(*task)(worker);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--remaining == 0)
+				finished.notify_one();
+		}
+	};
+};
+#endif
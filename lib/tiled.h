@@ -0,0 +1,463 @@
+#ifndef TILED_H
+#define TILED_H
+
+#include <glad/glad.h>
+
+#include <cmath>
+#include <vector>
+#include <iostream>
+#include <algorithm>
+#include <random>
+
+#include "json.hpp"
+using json = nlohmann::json;
+
+#include "shader.h"
+#include "simulation.h"
+
+
+// part of the map a simulation covers, an empty one means all of it
+struct mapRegion {
+	int x = 0;
+	int y = 0;
+	int width = 0;
+	int height = 0;
+};
+
+class tiledSimulation
+{
+	// a simulation whose map is split into square tiles with halo borders
+	// -------------------------------------------------------------------
+	// every tile is one layer of the trail and deposit array textures, its halo
+	// holds copies of the neighbouring tiles' edges so blurring and sensing
+	// near a tile edge never needs another layer, the halos are refreshed with
+	// GPU copies every step
+	// agents stay in one buffer and pick their tile from their position, so an
+	// agent crossing a tile edge simply reads and deposits in the next tile
+	// the trail only stores intensity (r16f), with the deposit counts that is
+	// 8 bytes per pixel instead of 36, a 32768x32768 map needs about 8.6 GB
+	// a simulation can also cover only a region of the map, the halos along
+	// the region's edges are then filled by whoever owns the rest
+public:
+	unsigned int width = 0;
+	unsigned int height = 0;
+	mapRegion region;
+
+	// agent slots in use and slots the agent buffer has room for
+	unsigned int agentNumber = 0;
+	unsigned int agentCapacity = 0;
+	unsigned int seed = 0;
+
+	// simulation step counter, drives the random streams in the shaders
+	unsigned int frameIndex = 0;
+
+	// interior size of a tile, halo width around it and tiles per row/column
+	int tileSize = 0;
+	int halo = 0;
+	int tilesX = 0;
+	int tilesY = 0;
+
+	simulationSettings settings;
+
+	unsigned int trailTextures[2] = {0, 0};
+	unsigned int depositTexture = 0;
+	int currentTrail = 0;
+
+	unsigned int settingsSSBO = 0;
+	unsigned int agentDataSSBO = 0;
+
+	unsigned int VAO = 0, VBO = 0, EBO = 0;
+
+	tiledSimulation() {};
+
+	// true when the preset asks for tiles or the map doesn't fit in one texture
+	static bool needsTiles(const json &preset)
+	{
+		int maxTextureSize;
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+
+		return preset.contains("tileSize")
+			|| preset["mapWidth"] > maxTextureSize
+			|| preset["mapHeight"] > maxTextureSize;
+	};
+
+	// pixels of the neighbouring tiles kept around every tile, sensors reach
+	// at most sensorDistance + sensorSize pixels (rounded up) from an agent
+	static int haloFor(const json &preset)
+	{
+		simulationSettings sensing = readSimulationSettings(preset);
+		return std::max(2, (int)std::ceil(sensing.sensorDistance) + std::max(0, sensing.sensorSize) + 1);
+	};
+
+	// splits the map (or region of it) into tiles, allocates them, clears the
+	// trail and spawns the agents inside, with room for spareAgents more
+	bool load(const json &preset, mapRegion area = mapRegion(), unsigned int spareAgents = 0)
+	{
+		if (VAO == 0)
+			createScreenQuad(VAO, VBO, EBO);
+
+		readSettings(preset);
+
+		halo = haloFor(preset);
+
+		int maxTextureSize, maxLayers;
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+		width = preset["mapWidth"];
+		height = preset["mapHeight"];
+
+		region = area;
+		if (region.width <= 0 || region.height <= 0)
+			region = {0, 0, (int)width, (int)height};
+
+		// tiles never need to be bigger than the region
+		tileSize = preset.value("tileSize", 4096);
+		tileSize = std::min(tileSize, std::max(region.width, region.height));
+		tileSize = std::max(std::min(tileSize, maxTextureSize - 2 * halo), halo);
+		tilesX = (region.width + tileSize - 1) / tileSize;
+		tilesY = (region.height + tileSize - 1) / tileSize;
+
+		if (tilesX * tilesY > maxLayers)
+		{
+			std::cout << "Map needs " << tilesX * tilesY << " tiles, only " << maxLayers << " fit in an array texture, use a bigger tileSize." << std::endl;
+			return false;
+		}
+
+		if (!createTextures())
+			return false;
+
+		float trailClear = 0.0f;
+		glClearTexImage(trailTextures[0], 0, GL_RED, GL_FLOAT, &trailClear);
+		glClearTexImage(trailTextures[1], 0, GL_RED, GL_FLOAT, &trailClear);
+		glClearTexImage(depositTexture, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &depositClear);
+		currentTrail = 0;
+		frameIndex = 0;
+
+		spawnAgents(preset, spareAgents);
+		return true;
+	};
+
+	// copies settings from the preset into the settings SSBO
+	void readSettings(const json &preset)
+	{
+		settings = readSimulationSettings(preset);
+
+		if (settingsSSBO == 0)
+		{
+			glGenBuffers(1, &settingsSSBO);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, settingsSSBO);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(settings), &settings, GL_DYNAMIC_DRAW);
+		}
+		else
+		{
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, settingsSSBO);
+			glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(settings), &settings);
+		}
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	};
+
+	// one simulation step: diffuse every tile, refresh halos, move the agents
+	void step(computeShader &diffuseShader, computeShader &agentShader)
+	{
+		diffuse(diffuseShader);
+		moveAgents(agentShader);
+		shareDeposits();
+	};
+
+	// blur + decay the inside of every tile in one dispatch, then refresh
+	// the trail halos between tiles
+	void diffuse(computeShader &diffuseShader)
+	{
+		diffuseShader.use();
+		setTileUniforms(diffuseShader);
+
+		glBindImageTexture(1, trailTextures[currentTrail], 0, GL_TRUE, 0, GL_READ_ONLY, GL_R16F);
+		glBindImageTexture(2, depositTexture, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+		glBindImageTexture(5, trailTextures[1 - currentTrail], 0, GL_TRUE, 0, GL_WRITE_ONLY, GL_R16F);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, settingsSSBO);
+
+		// has to match the 8x8 local size in diffuse.comp
+		diffuseShader.dispatch((tileSize + 7) / 8, (tileSize + 7) / 8, tilesX * tilesY);
+
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+		glClearTexImage(depositTexture, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, &depositClear);
+		currentTrail = 1 - currentTrail;
+
+		// the agents sense up to halo pixels past their tile
+		exchangeHalos(trailTextures[currentTrail], halo);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+	};
+
+	// moves the agents of all tiles in one dispatch
+	void moveAgents(computeShader &agentShader)
+	{
+		agentShader.use();
+		setTileUniforms(agentShader);
+
+		agentShader.setUint("frame", frameIndex++);
+		agentShader.setUint("seed", seed);
+
+		glBindImageTexture(1, trailTextures[currentTrail], 0, GL_TRUE, 0, GL_READ_ONLY, GL_R16F);
+		glBindImageTexture(2, depositTexture, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32UI);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, settingsSSBO);
+
+		// bind only the slots in use, the buffer can have spare ones
+		if (agentNumber > 0)
+		{
+			glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 4, agentDataSSBO, 0, agentNumber * sizeof(agent));
+
+			// has to match local_size_x in the compute shader
+			const int computeDivisor = 64;
+			agentShader.dispatch((agentNumber + computeDivisor - 1) / computeDivisor, 1);
+		}
+
+		// deposits and agents are read next by the halo copies, the blur,
+		// the next agent step and display, as images, copies and buffers
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT |
+			GL_TEXTURE_FETCH_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+	};
+
+	// the next blur reads one pixel of deposits past every tile edge
+	void shareDeposits()
+	{
+		exchangeHalos(depositTexture, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT);
+	};
+
+	// draws the whole map scaled to a viewportWidth x viewportHeight framebuffer
+	void display(vertFragShader &displayShader, int viewportWidth, int viewportHeight)
+	{
+		displayShader.use();
+		setTileUniforms(displayShader);
+		displayShader.setVec2("mapScale", (float)width / std::max(1, viewportWidth), (float)height / std::max(1, viewportHeight));
+
+		glBindVertexArray(VAO);
+
+		glBindImageTexture(1, trailTextures[currentTrail], 0, GL_TRUE, 0, GL_READ_ONLY, GL_R16F);
+		glBindImageTexture(2, depositTexture, 0, GL_TRUE, 0, GL_READ_ONLY, GL_R32UI);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, settingsSSBO);
+
+		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	};
+
+	// reads rows [y, y + rows) of the region (its whole width) from texture
+	// (a trail or the deposit texture) as 16 bit floats or 32 bit counts
+	void readRows(unsigned int texture, int y, int rows, std::vector<char> &data)
+	{
+		transferRows(texture, y, rows, data, false);
+	};
+
+	// writes rows [y, y + rows) of the region's width into texture, wherever
+	// tiles hold them (halos included), the other end of readRows
+	void writeRows(unsigned int texture, int y, int rows, std::vector<char> &data)
+	{
+		transferRows(texture, y, rows, data, true);
+	};
+
+	// reads the trail intensity of one tile (halo included) back (stalls, for offline use)
+	void readTile(int tileX, int tileY, std::vector<float> &pixels)
+	{
+		int side = tileSize + 2 * halo;
+		pixels.resize((size_t)side * side);
+		glGetTextureSubImage(trailTextures[currentTrail], 0, 0, 0, tileY * tilesX + tileX, side, side, 1,
+			GL_RED, GL_FLOAT, pixels.size() * sizeof(float), pixels.data());
+	};
+
+private:
+	size_t allocatedAgents = 0;
+	size_t allocatedLayers = 0;
+	int allocatedSide = 0;
+	unsigned int depositClear = 0;
+
+	template <typename shaderType>
+	void setTileUniforms(shaderType &shader)
+	{
+		shader.setInt("tileSize", tileSize);
+		shader.setInt("tileHalo", halo);
+		shader.setIvec2("tileCount", tilesX, tilesY);
+		shader.setIvec2("regionOrigin", region.x, region.y);
+		shader.setIvec2("regionEnd", region.x + region.width, region.y + region.height);
+	};
+
+	bool createTextures()
+	{
+		int side = tileSize + 2 * halo;
+		size_t layers = (size_t)tilesX * tilesY;
+
+		if (side == allocatedSide && layers == allocatedLayers)
+			return true;
+
+		if (depositTexture != 0)
+		{
+			glDeleteTextures(2, trailTextures);
+			glDeleteTextures(1, &depositTexture);
+		}
+
+		// 2 bytes per trail pixel (twice for ping-pong) and 4 per deposit count
+		double megabytes = (double)side * side * layers * 8 / (1024.0 * 1024.0);
+		std::cout << "Tiled map: " << tilesX << "x" << tilesY << " tiles of " << tileSize << " pixels (halo " << halo << "), "
+			<< (int)megabytes << " MiB of textures." << std::endl;
+
+		glGenTextures(2, trailTextures);
+		glGenTextures(1, &depositTexture);
+
+		while (glGetError() != GL_NO_ERROR) {}
+
+		for (int i = 0; i < 2; i++)
+		{
+			glBindTexture(GL_TEXTURE_2D_ARRAY, trailTextures[i]);
+			glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R16F, side, side, layers);
+		}
+
+		glBindTexture(GL_TEXTURE_2D_ARRAY, depositTexture);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R32UI, side, side, layers);
+
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+		if (glGetError() == GL_OUT_OF_MEMORY)
+		{
+			std::cout << "Not enough GPU memory for the tiled map." << std::endl;
+			glDeleteTextures(2, trailTextures);
+			glDeleteTextures(1, &depositTexture);
+			trailTextures[0] = trailTextures[1] = depositTexture = 0;
+			allocatedSide = 0;
+			allocatedLayers = 0;
+			return false;
+		}
+
+		allocatedSide = side;
+		allocatedLayers = layers;
+		return true;
+	};
+
+	// copies the edges of every tile's interior into the halos of its (up to 8)
+	// neighbours, haloWidth pixels deep
+	void exchangeHalos(unsigned int texture, int haloWidth)
+	{
+		for (int tileY = 0; tileY < tilesY; tileY++)
+		{
+			for (int tileX = 0; tileX < tilesX; tileX++)
+			{
+				int originX = region.x + tileX * tileSize;
+				int originY = region.y + tileY * tileSize;
+
+				for (int dy = -1; dy <= 1; dy++)
+				{
+					for (int dx = -1; dx <= 1; dx++)
+					{
+						int neighbourX = tileX + dx;
+						int neighbourY = tileY + dy;
+						if ((dx == 0 && dy == 0) || neighbourX < 0 || neighbourY < 0 || neighbourX >= tilesX || neighbourY >= tilesY)
+							continue;
+
+						// map coordinates of this part of the halo, clipped to
+						// the neighbour's part of the region
+						int x0 = dx < 0 ? originX - haloWidth : (dx == 0 ? originX : originX + tileSize);
+						int y0 = dy < 0 ? originY - haloWidth : (dy == 0 ? originY : originY + tileSize);
+						int x1 = std::min(dx == 0 ? originX + tileSize : x0 + haloWidth, region.x + region.width);
+						int y1 = std::min(dy == 0 ? originY + tileSize : y0 + haloWidth, region.y + region.height);
+						if (x1 <= x0 || y1 <= y0)
+							continue;
+
+						int neighbourOriginX = region.x + neighbourX * tileSize;
+						int neighbourOriginY = region.y + neighbourY * tileSize;
+
+						glCopyImageSubData(
+							texture, GL_TEXTURE_2D_ARRAY, 0,
+							x0 - neighbourOriginX + halo, y0 - neighbourOriginY + halo, neighbourY * tilesX + neighbourX,
+							texture, GL_TEXTURE_2D_ARRAY, 0,
+							x0 - originX + halo, y0 - originY + halo, tileY * tilesX + tileX,
+							x1 - x0, y1 - y0, 1);
+					}
+				}
+			}
+		}
+	};
+
+	// copies rows between data (region wide, tightly packed) and the tiles,
+	// reads come from tile interiors, writes go to every tile holding the rows
+	void transferRows(unsigned int texture, int y, int rows, std::vector<char> &data, bool write)
+	{
+		bool trail = texture != depositTexture;
+		GLenum format = trail ? GL_RED : GL_RED_INTEGER;
+		GLenum type = trail ? GL_HALF_FLOAT : GL_UNSIGNED_INT;
+		size_t pixelSize = trail ? 2 : 4;
+
+		data.resize((size_t)region.width * rows * pixelSize);
+
+		glPixelStorei(write ? GL_UNPACK_ROW_LENGTH : GL_PACK_ROW_LENGTH, region.width);
+		glPixelStorei(write ? GL_UNPACK_ALIGNMENT : GL_PACK_ALIGNMENT, 1);
+
+		int reach = write ? halo : 0;
+		for (int tileY = 0; tileY < tilesY; tileY++)
+		{
+			for (int tileX = 0; tileX < tilesX; tileX++)
+			{
+				int originX = region.x + tileX * tileSize;
+				int originY = region.y + tileY * tileSize;
+
+				int x0 = std::max(originX - reach, region.x);
+				int x1 = std::min(originX + tileSize + reach, region.x + region.width);
+				int y0 = std::max(originY - reach, y);
+				int y1 = std::min(originY + tileSize + reach, y + rows);
+				if (!write)
+					y1 = std::min(y1, region.y + region.height);
+				if (x1 <= x0 || y1 <= y0)
+					continue;
+
+				size_t offset = ((size_t)(y0 - y) * region.width + (x0 - region.x)) * pixelSize;
+				int localX = x0 - originX + halo;
+				int localY = y0 - originY + halo;
+				int layer = tileY * tilesX + tileX;
+
+				if (write)
+					glTextureSubImage3D(texture, 0, localX, localY, layer, x1 - x0, y1 - y0, 1, format, type, data.data() + offset);
+				else
+					glGetTextureSubImage(texture, 0, localX, localY, layer, x1 - x0, y1 - y0, 1, format, type, data.size() - offset, data.data() + offset);
+			}
+		}
+
+		glPixelStorei(write ? GL_UNPACK_ROW_LENGTH : GL_PACK_ROW_LENGTH, 0);
+		glPixelStorei(write ? GL_UNPACK_ALIGNMENT : GL_PACK_ALIGNMENT, 4);
+	};
+
+	void spawnAgents(const json &preset, unsigned int spareAgents)
+	{
+		unsigned int mapAgents = preset["agentNumber"];
+		seed = presetSeed(preset);
+
+		// spawn the agents of the whole map and keep the ones in the region,
+		// so splitting the map doesn't change where agents start
+		std::mt19937 gen(seed);
+		auto randomUnit = [&gen]() { return gen() / 4294967296.0; };
+
+		std::vector<agent> agents;
+		for (unsigned int i = 0; i < mapAgents; i++)
+		{
+			agent t = spawnAgent(preset["spawnMethod"], width, height, randomUnit);
+
+			int x = std::min((int)t.x, (int)width - 1);
+			int y = std::min((int)t.y, (int)height - 1);
+			if (x >= region.x && x < region.x + region.width && y >= region.y && y < region.y + region.height)
+				agents.push_back(t);
+		}
+		agentNumber = agents.size();
+		agentCapacity = agentNumber + spareAgents;
+
+		if (agentDataSSBO == 0)
+			glGenBuffers(1, &agentDataSSBO);
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, agentDataSSBO);
+		if (allocatedAgents != agentCapacity)
+		{
+			glBufferData(GL_SHADER_STORAGE_BUFFER, std::max(1u, agentCapacity) * sizeof(agent), NULL, GL_DYNAMIC_READ);
+			allocatedAgents = agentCapacity;
+		}
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, agentNumber * sizeof(agent), agents.data());
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	};
+};
+#endif
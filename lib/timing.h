@@ -0,0 +1,288 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <ctime>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+// CPU time used by this process so far, all threads
+inline double processCpuSeconds()
+{
+	#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+
+	// 100 ns units
+	auto seconds = [](FILETIME time) { return (((unsigned long long)time.dwHighDateTime << 32) | time.dwLowDateTime) * 1e-7; };
+	return seconds(kernel) + seconds(user);
+	#else
+	timespec time;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+	return time.tv_sec + time.tv_nsec * 1e-9;
+	#endif
+}
+
+class stepTimer
+{
+	// GPU time of the simulation steps
+	// --------------------------------
+	// every step is wrapped in a GL_TIME_ELAPSED query, results are only read
+	// once the ring wrapped around to a query that is a few frames old, so the
+	// CPU never waits on the GPU for them
+	// utilisation is the share of wall time since the last report the GPU
+	// spent on steps and the process spent on a CPU (100% is one core)
+public:
+	// the ring has to be longer than the frames in flight, or reading a
+	// result waits for the GPU
+	stepTimer(bool enabled, int printEvery = 60, int framesInFlight = 3)
+		: enabled(enabled), printEvery(printEvery), ringSize(std::max(4, framesInFlight + 1)),
+		queries(ringSize, 0), issued(ringSize, false)
+	{
+		if (enabled)
+			glGenQueries(ringSize, queries.data());
+
+		reportStart = std::chrono::steady_clock::now();
+		reportCpuStart = processCpuSeconds();
+	};
+
+	~stepTimer()
+	{
+		if (enabled)
+			glDeleteQueries(ringSize, queries.data());
+	};
+
+	stepTimer(const stepTimer&) = delete;
+	stepTimer& operator=(const stepTimer&) = delete;
+
+	void begin()
+	{
+		if (!enabled)
+			return;
+
+		// collect the result this query held before reusing it
+		if (issued[current])
+		{
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(queries[current], GL_QUERY_RESULT, &nanoseconds);
+			totalNanoseconds += nanoseconds;
+			measured++;
+		}
+
+		glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+	};
+
+	void end()
+	{
+		if (!enabled)
+			return;
+
+		glEndQuery(GL_TIME_ELAPSED);
+		issued[current] = true;
+		current = (current + 1) % ringSize;
+	};
+
+	// true once printEvery steps were measured since the last print
+	bool printing() const
+	{
+		return enabled && measured >= printEvery;
+	};
+
+	// average GPU ms per step and GPU / CPU utilisation in percent since the
+	// last report, restarts all three
+	void report(double &milliseconds, double &gpuPercent, double &cpuPercent)
+	{
+		auto now = std::chrono::steady_clock::now();
+		double wallSeconds = std::chrono::duration<double>(now - reportStart).count();
+		double cpuSeconds = processCpuSeconds();
+
+		milliseconds = measured > 0 ? totalNanoseconds / 1e6 / measured : 0.0;
+		gpuPercent = wallSeconds > 0 ? 100.0 * totalNanoseconds / 1e9 / wallSeconds : 0.0;
+		cpuPercent = wallSeconds > 0 ? 100.0 * (cpuSeconds - reportCpuStart) / wallSeconds : 0.0;
+
+		totalNanoseconds = 0;
+		measured = 0;
+		reportStart = now;
+		reportCpuStart = cpuSeconds;
+	};
+
+private:
+	bool enabled;
+	int printEvery;
+	int ringSize;
+
+	std::vector<unsigned int> queries;
+	std::vector<bool> issued;
+	int current = 0;
+
+	double totalNanoseconds = 0;
+	int measured = 0;
+
+	std::chrono::steady_clock::time_point reportStart;
+	double reportCpuStart;
+};
+
+class framePipeline
+{
+	// frames in flight
+	// ----------------
+	// every frame ends with a fence, and a frame only starts once the fence
+	// of the frame framesInFlight before it signaled, so the CPU queues the
+	// next frames (settings, input, capture writes, ...) while the GPU still
+	// works on earlier ones, but never gets more than framesInFlight ahead
+	// (1 makes every frame wait for the one before, like an idle GPU would)
+	// when measuring, GL_TIMESTAMP queries mark where every frame's GPU work
+	// starts and ends, read once its fence signaled so they never stall,
+	// idle is the GPU time between the end of one frame and the start of
+	// the next, i.e. the GPU waiting for commands
+public:
+	framePipeline(int framesInFlight, bool measuring)
+		: measuring(measuring), slots(std::max(1, framesInFlight))
+	{
+		if (measuring)
+			for (frameSlot &slot : slots)
+				glGenQueries(2, slot.queries);
+	};
+
+	~framePipeline()
+	{
+		for (frameSlot &slot : slots)
+		{
+			if (slot.fence != 0)
+				glDeleteSync(slot.fence);
+			if (measuring)
+				glDeleteQueries(2, slot.queries);
+		}
+	};
+
+	framePipeline(const framePipeline&) = delete;
+	framePipeline& operator=(const framePipeline&) = delete;
+
+	int framesInFlight() const
+	{
+		return (int)slots.size();
+	};
+
+	// waits until this frame may start, before the frame's first GL command
+	void begin()
+	{
+		frameSlot &slot = slots[current];
+
+		if (slot.fence != 0)
+		{
+			auto start = std::chrono::steady_clock::now();
+			while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull) == GL_TIMEOUT_EXPIRED)
+			{
+			}
+			waitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			glDeleteSync(slot.fence);
+			slot.fence = 0;
+
+			if (measuring)
+				collect(slot);
+		}
+
+		if (measuring)
+			glQueryCounter(slot.queries[0], GL_TIMESTAMP);
+	};
+
+	// after the frame's last GL command
+	void end()
+	{
+		frameSlot &slot = slots[current];
+
+		if (measuring)
+			glQueryCounter(slot.queries[1], GL_TIMESTAMP);
+
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		current = (current + 1) % slots.size();
+	};
+
+	// average GPU idle ms between frames, idle share of the GPU timeline and
+	// average ms the CPU waited on fences, per frame since the last report,
+	// restarts all three
+	void report(double &idleMilliseconds, double &idlePercent, double &waitMilliseconds)
+	{
+		idleMilliseconds = measured > 0 ? idleNanoseconds / 1e6 / measured : 0.0;
+		idlePercent = idleNanoseconds + busyNanoseconds > 0 ? 100.0 * idleNanoseconds / (idleNanoseconds + busyNanoseconds) : 0.0;
+		waitMilliseconds = measured > 0 ? waitSeconds * 1e3 / measured : 0.0;
+
+		idleNanoseconds = 0;
+		busyNanoseconds = 0;
+		waitSeconds = 0;
+		measured = 0;
+	};
+
+private:
+	struct frameSlot {
+		GLsync fence = 0;
+		unsigned int queries[2] = {}; // GPU timestamps of the frame's start and end
+	};
+
+	bool measuring;
+	std::vector<frameSlot> slots;
+	size_t current = 0;
+
+	// end of the last frame collected, frames are collected in order
+	GLuint64 lastEnd = 0;
+
+	double idleNanoseconds = 0;
+	double busyNanoseconds = 0;
+	double waitSeconds = 0;
+	int measured = 0;
+
+	void collect(frameSlot &slot)
+	{
+		GLuint64 start = 0, end = 0;
+		glGetQueryObjectui64v(slot.queries[0], GL_QUERY_RESULT, &start);
+		glGetQueryObjectui64v(slot.queries[1], GL_QUERY_RESULT, &end);
+
+		if (lastEnd != 0 && start > lastEnd)
+			idleNanoseconds += (double)(start - lastEnd);
+		if (end > start)
+			busyNanoseconds += (double)(end - start);
+
+		lastEnd = end;
+		measured++;
+	};
+};
+
+class framePacer
+{
+	// caps the frame loop at maxFps by sleeping until the next frame is due,
+	// a frame that ran late starts the schedule over instead of rushing
+	// the following ones, 0 means no cap
+public:
+	framePacer(double maxFps)
+	{
+		if (maxFps > 0)
+			period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / maxFps));
+		next = std::chrono::steady_clock::now();
+	};
+
+	void wait()
+	{
+		if (period.count() == 0)
+			return;
+
+		next += period;
+		auto now = std::chrono::steady_clock::now();
+		if (next < now)
+			next = now;
+		else
+			std::this_thread::sleep_until(next);
+	};
+
+private:
+	std::chrono::steady_clock::duration period = std::chrono::steady_clock::duration::zero();
+	std::chrono::steady_clock::time_point next;
+};
+#endif
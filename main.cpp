@@ -1,23 +1,38 @@
 #include <glad/glad.h> 
 #include <GLFW/glfw3.h>
 
+#ifdef _WIN32
 #include <Windows.h>
-#define _USE_MATH_DEFINES // to get M_PI
-#include <math.h>
+#endif
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <random>
 #include <string>
+#include <memory>
 #include <algorithm>
+#include <functional>
 
 #include "lib/json.hpp"
 using json = nlohmann::json;
 
 
 #include "lib/shader.h"
-
-
+#include "lib/capture.h"
+#include "lib/display.h"
+#include "lib/timing.h"
+#include "lib/simulation.h"
+#include "lib/tiled.h"
+#include "lib/sweep.h"
+#include "lib/distributed.h"
+#include "lib/cpuSimulation.h"
+#include "lib/fileWatcher.h"
+#include "lib/shaderReloader.h"
+
+
+bool readPreset(const std::string &presetName, json &preset);
+std::string simulationShaderPath(const json &preset);
+std::vector<shaderSource> shaderSources(const json &preset, bool tiled);
+void reloadPreset(const std::string &presetName, json &settingsJson, std::function<void(const json&)> applySettings, bool &shaderChanged, int tileHalo);
 void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow *window, bool &fullscreen, bool &paused, int width, int height);
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
@@ -51,20 +66,46 @@ int main(int argc, char** argv)
 		return -1;
 	}
 
-	std::string filePath = "presets/" + std::string(argv[1]) + ".json";
+	json settingsJson;
+	if (!readPreset(argv[1], settingsJson))
+		return -1;
 
-	std::ifstream presetFile(filePath);
+	// sweep presets name the preset they start from in "sweep": {"base": ...},
+	// everything else below is set up from that base preset
+	json basePreset;
+	if (settingsJson.contains("sweep"))
+	{
+		json sweepSettings = settingsJson["sweep"];
+		if (!readPreset(sweepSettings.value("base", ""), basePreset))
+			return -1;
 
-	if(!presetFile)
+		settingsJson = basePreset;
+		settingsJson["sweep"] = sweepSettings;
+	}
+
+	// distributed presets split the preset named in "distributed": {"base": ...}
+	// over several worker processes, this process only coordinates them
+	if (settingsJson.contains("distributed"))
 	{
-		std::cout << "Preset file with relative path: ";
-		std::cout << filePath;
-		std::cout << " doesn't exist.";
-		return -1;
+		json studySettings = settingsJson["distributed"];
+		if (!readPreset(studySettings.value("base", ""), basePreset))
+			return -1;
+
+		scalingStudy study(studySettings, basePreset);
+		return study.run();
 	}
 
-	json settingsJson;
-	presetFile >> settingsJson;
+	// cpu presets benchmark the CPU simulation with the preset named in
+	// "cpu": {"base": ...}, no window or GL context is needed for it
+	if (settingsJson.contains("cpu"))
+	{
+		json benchmarkSettings = settingsJson["cpu"];
+		if (!readPreset(benchmarkSettings.value("base", ""), basePreset))
+			return -1;
+
+		cpuBenchmark benchmark(benchmarkSettings, basePreset);
+		return benchmark.run();
+	}
 
 	// glfw setup
 
@@ -89,10 +130,16 @@ int main(int argc, char** argv)
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
 	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, true);
+
+	// the window is sized and shown once the context tells whether the map
+	// needs tiles, sweeps never show it
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
 	// remove after done
 	//glfwWindowHint(GLFW_DECORATED, false);
 
-	GLFWwindow* window = glfwCreateWindow(PROGRAM_SETTINGS.width, PROGRAM_SETTINGS.height, "Slime sim", NULL, NULL);
+	GLFWwindow* window = glfwCreateWindow(1, 1, "Slime sim", NULL, NULL);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
 	
 	if (window == NULL)
 	{
@@ -113,341 +160,431 @@ int main(int argc, char** argv)
 		return -1;
 	}
 
-	
-	// build and compile shader programs
-	// --------------------------------
-	vertFragShader generalShader("shaders/Vertex.vert", "shaders/Fragment.frag");
 
-	// default to final compute shader
-	computeShader simShader("shaders/slimeFinal.comp");
-
-	// choose simulation level based on settings preset
-	if(settingsJson["simulationShader"] == "stageFinal")
+	// maps bigger than a texture (or with a "tileSize") are split into tiles
+	// ----------------------------------------------------------------------
+	bool tiled = !settingsJson.contains("sweep") && tiledSimulation::needsTiles(settingsJson);
+	if (tiled && settingsJson["simulationShader"] != "stageFinal")
 	{
-		simShader = computeShader("shaders/slimeFinal.comp");
-	}
-	else
-	{
-		std::string option = settingsJson["simulationShader"];
-		std::string shaderpath = "shaders/" + option + ".comp";
-		simShader = computeShader(shaderpath.c_str());
+		std::cout << "Tiled maps only work with the stageFinal simulation shader." << std::endl;
+		glfwTerminate();
+		return -1;
 	}
-	
 
-	// set up vertex data and buffers
-	// ------------------------------
-	float rectangleVertices[] = {
-		// rectangle is made from 2 triangles
-		// positions        // colors          // texture coords
-		1.0f,  1.0f, 0.0f,  1.0f, 0.0f, 0.0f,  1.0f, 1.0f, // top right
-		1.0f, -1.0f, 0.0f,  0.0f, 1.0f, 0.0f,  1.0f, 0.0f, // bot right
-	   -1.0f, -1.0f, 0.0f,  0.0f, 0.0f, 0.0f,  0.0f, 0.0f, // bot left
-	   -1.0f,  1.0f, 0.0f,  0.0f, 0.0f, 1.0f,  0.0f, 1.0f // top left
-	};
+	// the map is drawn at renderScale times its size (tiled maps default to
+	// fitting the monitor) and the window starts at that size or as much of
+	// it as fits, any later window size just scales the drawn image
+	// ---------------------------------------------------------------------
+	double monitorFit = 1.0;
+	const GLFWvidmode *mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+	if (mode != NULL)
+		monitorFit = std::min({1.0, (double)mode->width / PROGRAM_SETTINGS.width, (double)mode->height / PROGRAM_SETTINGS.height});
 
-	unsigned int indices[] = { // order for drawing vertices
-		0, 1, 3, // first trinagle
-		1, 2, 3  // second triangle
-	};
+	double renderScale = settingsJson.value("renderScale", tiled ? monitorFit : 1.0);
+	int renderWidth = std::max(1, (int)(PROGRAM_SETTINGS.width * renderScale));
+	int renderHeight = std::max(1, (int)(PROGRAM_SETTINGS.height * renderScale));
 
+	double windowScale = std::min(renderScale, monitorFit);
+	PROGRAM_SETTINGS.width = std::max(1, (int)(PROGRAM_SETTINGS.width * windowScale));
+	PROGRAM_SETTINGS.height = std::max(1, (int)(PROGRAM_SETTINGS.height * windowScale));
 
-	// general VBO, VAO, EBO setup using data above
-	// --------------------------------------------
-	unsigned int VBO, VAO, EBO;
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
-
-	// bind vertex array object first, then bind and set vertex buffer, then configure vertex attributes
-	glBindVertexArray(VAO);
-
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(rectangleVertices), rectangleVertices, GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	// configure vertex attributes
-	// ---------------------------
-	// position attrib
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float),  (void*)0);
-	glEnableVertexAttribArray(0);
-
-	// color attrib
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float),  (void*)(3 * sizeof(float)));
-	glEnableVertexAttribArray(1);
-
-	// texture coord attrib
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float),  (void*)(6 * sizeof(float)));
-	glEnableVertexAttribArray(2);
-
-	// generate empty trail and agents textures and all params for it
-	// --------------------------------------------------------------
-	unsigned int trailTexture, agentTexture;
-	glGenTextures(1, &trailTexture);
-	glGenTextures(1, &agentTexture);
-
-	// trail texture setup
-	glBindTexture(GL_TEXTURE_2D, trailTexture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, PROGRAM_SETTINGS.width, PROGRAM_SETTINGS.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-
-	// agent texture setup
-	glBindTexture(GL_TEXTURE_2D, agentTexture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, PROGRAM_SETTINGS.width, PROGRAM_SETTINGS.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
-
-	float alphaVal[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-	glClearTexImage(agentTexture, 0, GL_RGBA, GL_FLOAT, alphaVal);
-
-	// setting up agent settings for compute shaders
-	// ----------------------------------------------
-
-	// create and populate settings struct
-	struct settings{
-		// agent settings
-		// --------------
-		float moveSpeed;
-		float turnSpeed;
-		float sensorAngle;
-		float sensorDistance;
-
-		// map size settings
-		// ------------
-		int width;
-		int height;
-
-		// diffusion and decay settings
-		// ----------------------------
-		float color_r;
-		float color_g;
-		float color_b;
-		float decayRate;
-		float diffuseRate;
-
-	} simulationSettings;
-
-	// can't assign values to variables above from the json
-	// file so i have to do the assigning bellow
-	simulationSettings.moveSpeed = settingsJson["moveSpeed"];
-	simulationSettings.turnSpeed = settingsJson["turnSpeed"];
-	simulationSettings.sensorAngle = settingsJson["sensorAngle"];
-	simulationSettings.sensorDistance = settingsJson["sensorDistance"];
-
-	simulationSettings.width = settingsJson["mapWidth"];
-	simulationSettings.height = settingsJson["mapHeight"];
-
-	simulationSettings.color_r = settingsJson["color_r"];
-	simulationSettings.color_r /= 255.0f;
-	simulationSettings.color_g = settingsJson["color_g"];
-	simulationSettings.color_g /= 255.0f;
-	simulationSettings.color_b = settingsJson["color_b"];
-	simulationSettings.color_b /= 255.0f;
-	simulationSettings.decayRate = settingsJson["decayRate"];
-	simulationSettings.diffuseRate = settingsJson["diffuseRate"];
-
-	// create settings SSBO and put settings struct into it
-	unsigned int settingsSSBO;
-	glGenBuffers(1, &settingsSSBO);
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, settingsSSBO);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(simulationSettings), &simulationSettings, GL_STATIC_DRAW);
+	glfwSetWindowSize(window, PROGRAM_SETTINGS.width, PROGRAM_SETTINGS.height);
+	glViewport(0, 0, PROGRAM_SETTINGS.width, PROGRAM_SETTINGS.height);
 
 	
-	// create agent struct and fill an array with agents
-	// -------------------------------------------------
-	unsigned int AGENT_NUM = settingsJson["agentNumber"];
-
-	struct agent {
-		float x;
-		float y;
-		float angle; // radians
-	};
-	
-	
-	// !!danger zone, be careful with malloc and free it at the end
-	// this is needed for bigger amount of agents that exceeds the max size
-	// of default arrays in c++
+	// build and compile shader programs
+	// --------------------------------
+	std::vector<shaderSource> sources = shaderSources(settingsJson, tiled);
 
-	agent *agentsArrPtr;
-	agentsArrPtr = (agent*) malloc(AGENT_NUM * sizeof(agent));
+	// display shader, draws the trail scaled to the render size
+	vertFragShader generalShader(sources[0].vertexPath.c_str(), sources[0].fragmentPath.c_str(), sources[0].defines);
 
-	// setup random device for angle, position, etc.. customization
-	// these devices are part of c++ random value generation
-	std::random_device rd;
-	std::mt19937 gen(rd());
+	// choose simulation level based on settings preset
+	computeShader simShader(sources[1].computePath.c_str(), sources[1].defines);
+
+	// blurs and decays the trail
+	computeShader diffuseShader(sources[2].computePath.c_str(), sources[2].defines);
 	
 
-	// initialize each agent with starting position and angle
-	// they are determined by user defined settings in the selected preset
-	for (int i = 0; i < AGENT_NUM; i++)
+	// create trail, deposit, settings and agent buffers from the preset
+	// -----------------------------------------------------------------
+	slimeSimulation simulation;
+	tiledSimulation tiledMap;
+
+	// a sweep preset runs its base preset many times without a visible window
+	if (settingsJson.contains("sweep"))
 	{
-		agent t;
+		parameterSweep sweep(settingsJson["sweep"], basePreset);
+		int result = sweep.run(simulation, diffuseShader, simShader);
+		simulation.finishMetrics();
 
-		int centreX = PROGRAM_SETTINGS.width / 2;
-		int centreY = PROGRAM_SETTINGS.height / 2;
+		glfwTerminate();
+		return result;
+	}
 
-		// spawns all agents in the middle, with random angles
-		if (settingsJson["spawnMethod"] == "centre")
+	if (tiled)
+	{
+		if (!tiledMap.load(settingsJson))
 		{
-			std::uniform_real_distribution<> randomAngle(0, 12.5662);
-			t.x = centreX;
-			t.y = centreY;
-			t.angle = randomAngle(gen);
+			glfwTerminate();
+			return -1;
 		}
-		// spawns all agents in the area of a circle with angles
-		// facing towards screen centre
-		else if (settingsJson["spawnMethod"] == "circle")
-		{
-			int radius = PROGRAM_SETTINGS.height / 3;
-			std::uniform_real_distribution<> randomAngle(0, 6.2831);
-			std::uniform_int_distribution<> randomRadius(0, radius);
+	}
+	else
+	{
+		simulation.load(settingsJson);
+	}
 
-			int distance = randomRadius(gen);
-			float genAngle = randomAngle(gen);
+	glfwShowWindow(window);
 
-			t.x = centreX + (cos(genAngle) * distance);
-			t.y = centreY + (sin(genAngle) * distance);
 
-			// get angle that is towards the circle centre
-			t.angle = genAngle + M_PI;
-		}
-		// spawns all agents with random angles and random position
-		else if (settingsJson["spawnMethod"] == "random")
-		{
-			std::uniform_real_distribution<> randomAngle(0, 6.2831);
-			std::uniform_int_distribution<> randomX(0, PROGRAM_SETTINGS.width);
-			std::uniform_int_distribution<> randomY(0, PROGRAM_SETTINGS.height);
+	// wireframe mode
+	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-			t.x = randomX(gen);
-			t.y = randomY(gen);
 
-			t.angle = randomAngle(gen);
-		}
 
-		agentsArrPtr[i] = t;
-	}
+	// optional GPU time per step, read a few frames late so it never stalls
+	// -----------------------------------------------------------------------
+	int framesInFlight = std::max(1, settingsJson.value("framesInFlight", 2));
+	stepTimer timer(settingsJson.value("printTiming", false), 60, framesInFlight);
 
-	// create and fill SSBO with agent array created above
-	// ---------------------------------------------------
-	unsigned int agentDataSSBO;
-	glGenBuffers(1, &agentDataSSBO);
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, agentDataSSBO);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, AGENT_NUM * sizeof(agent), agentsArrPtr, GL_DYNAMIC_READ);
-	// ooga booga free memory to make pc no crash
-	free(agentsArrPtr);
 
-	// unbind VAO, saving all buffers into it, then unbind buffers, texture
-	// --------------------------------------------------------------------
-	glBindVertexArray(0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	// idle policy: paused (or minimized, unless hidden windows keep
+	// simulating) the loop sleeps until an event comes in, running it is
+	// capped at maxFps
+	// ---------------------------------------------------------------------
+	framePacer pacer(settingsJson.value("maxFps", 0.0));
+	bool simulateHidden = settingsJson.value("whenHidden", "pause") == "simulate";
 
+	// the CPU runs at most framesInFlight frames ahead of the GPU, hidden
+	// or not (hidden frames aren't throttled by swapping)
+	framePipeline pipeline(framesInFlight, settingsJson.value("printTiming", false));
 
-	// wireframe mode
-	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
+	// offscreen image at render size, scaled into the window every frame
+	displayTarget view;
+	view.resize(renderWidth, renderHeight);
 
 
-	//TODO: performance testing delete after done
-	unsigned int timerQuery;
-	glGenQueries(1, &timerQuery);
+	// optional streaming of the displayed frames to a file or stdout, frames
+	// are read from the offscreen image so they don't change with the window
+	// -----------------------------------------------------------------------
+	frameCapture capture;
+	if (settingsJson.value("captureOutput", "") != "")
+	{
+		capture = frameCapture(
+			settingsJson.value("captureOutput", ""),
+			settingsJson.value("captureFormat", "y4m"),
+			renderWidth, renderHeight,
+			settingsJson.value("captureEvery", 1),
+			settingsJson.value("captureRing", 3),
+			settingsJson.value("captureFps", 60));
+	}
 
-	int timeElapsed;
 
-	
+	// edits to the preset or to shaders/ are applied while running, without
+	// re-spawning agents or clearing the trail
+	// -------------------------------------------------------------------------
+	std::unique_ptr<fileWatcher> watcher;
+	std::unique_ptr<shaderReloader> reloader;
+	if (settingsJson.value("hotReload", true))
+	{
+		watcher = std::make_unique<fileWatcher>(std::vector<std::string>{"presets", "shaders"}, []() { glfwPostEmptyEvent(); });
+		reloader = std::make_unique<shaderReloader>(window);
+	}
+
+	auto applySettings = [&](const json &preset)
+	{
+		if (tiled)
+			tiledMap.readSettings(preset);
+		else
+			simulation.readSettings(preset);
+	};
+
 
 	std::cout<<"Press SPACE for the simulation to start.";
 	while(!glfwWindowShouldClose(window))
 	{
+		if (watcher)
+		{
+			bool shaderChanged = false;
+
+			for (const std::string &path : watcher->changedFiles())
+			{
+				if (path == "presets/" + std::string(argv[1]) + ".json")
+					reloadPreset(argv[1], settingsJson, applySettings, shaderChanged, tiled ? tiledMap.halo : 0);
+				else if (path.rfind("shaders/", 0) == 0)
+					shaderChanged = true;
+			}
+
+			// compiled on the reloader's own context, swapped in once all of them
+			// linked, the single map's helper passes share includes with the
+			// main programs, so they're rebuilt along with them
+			if (shaderChanged)
+			{
+				std::vector<shaderSource> sources = shaderSources(settingsJson, tiled);
+				if (!tiled)
+				{
+					std::vector<shaderSource> helpers = simulation.helperSources();
+					sources.insert(sources.end(), helpers.begin(), helpers.end());
+				}
+				reloader->request(sources);
+			}
+
+			std::vector<unsigned int> programs;
+			if (reloader->finished(programs))
+			{
+				glDeleteProgram(generalShader.ID);
+				glDeleteProgram(simShader.ID);
+				glDeleteProgram(diffuseShader.ID);
+				generalShader.ID = programs[0];
+				simShader.ID = programs[1];
+				diffuseShader.ID = programs[2];
+				if (!tiled)
+					simulation.adoptHelperPrograms(std::vector<unsigned int>(programs.begin() + 3, programs.end()));
+				std::cout << "Shaders reloaded." << std::endl;
+			}
+		}
+
 
-		// guard clause shat skips compute shader part if the sim is paused
+		int framebufferWidth, framebufferHeight;
+		glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+
+		bool hidden = glfwGetWindowAttrib(window, GLFW_ICONIFIED) || framebufferWidth == 0 || framebufferHeight == 0;
+
+
+		// guard clause shat skips compute shader part if the sim is paused,
+		// the last drawn image is still shown (the window may have resized)
+		// and the loop blocks until something happens, hot reload wakes it
+		// when files changed or reloaded shaders are ready
 		// ----------------------------------------------------------------
-		if (PROGRAM_SETTINGS.paused)
+		if (PROGRAM_SETTINGS.paused || (hidden && !simulateHidden))
 		{
 			//simulationStarted = waitForStartInput(window);
 
-			glfwSwapBuffers(window);
-			glfwPollEvents();
+			if (!hidden)
+			{
+				view.present(framebufferWidth, framebufferHeight);
+				glfwSwapBuffers(window);
+			}
+
+			glfwWaitEvents();
 
 			continue;
 		}
 
 
-		// clear screen
-		// ------------
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
+		// move the simulation one step, then draw it at render size
+		// ----------------------------------------------------------
+		pipeline.begin();
+		timer.begin();
+		if (tiled)
+			tiledMap.step(diffuseShader, simShader);
+		else
+			simulation.step(diffuseShader, simShader);
+		timer.end();
 
+		// a hidden window only draws for the capture
+		if (!hidden || capture.enabled)
+		{
+			view.bind();
+			if (tiled)
+				tiledMap.display(generalShader, view.width, view.height);
+			else
+				simulation.display(generalShader, view.width, view.height);
+		}
 
-		// run general vertex and fragment shaders
-		// ---------------------------------------
-		generalShader.use();
-		glBindVertexArray(VAO);
+		// share of the map the next diffusion runs on (reading it stalls)
+		if (timer.printing())
+		{
+			double milliseconds, gpuPercent, cpuPercent;
+			timer.report(milliseconds, gpuPercent, cpuPercent);
+
+			double idleMilliseconds, idlePercent, waitMilliseconds;
+			pipeline.report(idleMilliseconds, idlePercent, waitMilliseconds);
+
+			std::cout << "step: " << milliseconds << " ms, GPU " << (int)gpuPercent << "%, CPU " << (int)cpuPercent << "%";
+			std::cout << ", GPU idle between frames: " << idleMilliseconds << " ms (" << (int)idlePercent << "%), fence wait: " << waitMilliseconds << " ms";
+			if (!tiled && simulation.sparse)
+				std::cout << ", active tiles: " << 100.0 * simulation.activeTiles() / (simulation.tilesX * simulation.tilesY) << "%";
+			if (!tiled && simulation.dynamic)
+				std::cout << ", agents: " << simulation.liveAgents();
+			std::cout << std::endl;
+		}
 
-		// bind textures texture to bindings in frag shader
-		glBindImageTexture(1, trailTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-		glBindImageTexture(2, agentTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
 
-		// bind settings SSBO to binding = 3 in frag shader
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, settingsSSBO);
-		
-		// draw the mainTexture on a whole screen rectangle 
-		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+		// queue readback of the drawn frame, writes out older ones
+		capture.frame();
 
-		
 
+		// glfw - swap buffers and poll events
+		// -----------------------------------
+		if (!hidden)
+		{
+			view.present(framebufferWidth, framebufferHeight);
+			glfwSwapBuffers(window);
+		}
+		pipeline.end();
+		glfwPollEvents();
 
-		// calculate new simulation step in compute shader
-		// ---------------------------------
-		simShader.use();
+		pacer.wait();
+	}
 
-		float timeValue = glfwGetTime();
-		simShader.setFloat("time", timeValue);
+	capture.finish();
+	if (!tiled)
+		simulation.finishMetrics();
+	
+	glfwTerminate();
+	return 0;
+}
 
-		// bind textures to bindings in compute shader
-		glBindImageTexture(1, trailTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-		glBindImageTexture(2, agentTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+bool readPreset(const std::string &presetName, json &preset)
+{
+	// reads presets/presetName.json into preset
+	std::string filePath = "presets/" + presetName + ".json";
 
-		// bind settings SSBO to binding = 3 in compute shader
-		// bind agent array SSBO to binding = 4 in compute shader
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, settingsSSBO);
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, agentDataSSBO);
+	std::ifstream presetFile(filePath);
 
-		//TODO: figure out how to calculate most optimal computeDivisor depending on AGENT_NUM
-		// change this value to make compute shader more efficient (1, 8, 16, 32)
-		const int computeDivisor = 64;
+	if(!presetFile)
+	{
+		std::cout << "Preset file with relative path: ";
+		std::cout << filePath;
+		std::cout << " doesn't exist.";
+		return false;
+	}
 
-		simShader.dispatch(AGENT_NUM/computeDivisor, 1);
+	presetFile >> preset;
+	return true;
+}
 
-		// stops execution until all compute shaders have finished work
-		glMemoryBarrier(GL_ALL_BARRIER_BITS);
-		
+std::string simulationShaderPath(const json &preset)
+{
+	// default to final compute shader
+	if(preset["simulationShader"] == "stageFinal")
+		return "shaders/slimeFinal.comp";
 
+	std::string option = preset["simulationShader"];
+	return "shaders/" + option + ".comp";
+}
 
+std::vector<shaderSource> shaderSources(const json &preset, bool tiled)
+{
+	// display (vertex + fragment), agent and diffusion programs of the running mode
+	std::vector<std::string> defines;
+	if (tiled)
+		defines.push_back("TILED");
+	else if (sparseTiles(preset))
+		defines.push_back("SPARSE");
+
+	// only the agent pass despawns agents and senses
+	std::vector<std::string> agentDefines = defines;
+	if (!tiled && dynamicPopulation(preset))
+		agentDefines.push_back("POPULATION");
+	if (!tiled && mipSensing(preset))
+		agentDefines.push_back("MIP_SENSING");
+	if (!tiled && satSensing(preset))
+		agentDefines.push_back("SAT_SENSING");
+	if (!tiled && headingVectors(preset))
+		agentDefines.push_back("HEADING_VECTOR");
+	if (!tiled && packedAgents(preset))
+		agentDefines.push_back("PACKED_AGENTS");
+	if (!tiled && measuredMetrics(preset))
+		agentDefines.push_back("METRICS");
+
+	return {
+		{"shaders/Vertex.vert", "shaders/display.frag", "", defines},
+		{"", "", simulationShaderPath(preset), agentDefines},
+		{"", "", "shaders/diffuse.comp", defines}
+	};
+}
 
-		// glfw - swap buffers and poll events
-		// -----------------------------------
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+void reloadPreset(const std::string &presetName, json &settingsJson, std::function<void(const json&)> applySettings, bool &shaderChanged, int tileHalo)
+{
+	// applies an edited preset to the running simulation, only settings that
+	// don't need new textures or agents can change this way, tileHalo is the
+	// halo of a tiled map, 0 for single maps
+	json newSettings;
+	try
+	{
+		if (!readPreset(presetName, newSettings))
+			return;
+	}
+	catch (json::exception &e)
+	{
+		// most likely saved halfway through an edit
+		std::cout << "Preset reload failed: " << e.what() << std::endl;
+		return;
 	}
 
-	
-	glfwTerminate();
-	return 0;
+	// puts the running value of key back if the edit changed it
+	auto keepSetting = [&](const char *key)
+	{
+		if (newSettings.value(key, json()) != settingsJson.value(key, json()))
+		{
+			std::cout << "Preset reload: '" << key << "' only changes after a restart." << std::endl;
+			if (settingsJson.contains(key))
+				newSettings[key] = settingsJson[key];
+			else
+				newSettings.erase(key);
+		}
+	};
+
+	for (const char *key : {"mapWidth", "mapHeight", "agentNumber", "spawnMethod", "seed", "tileSize", "sparseTiles", "maxAgents", "renderScale", "sensing", "heading", "agentFormat", "metricsOutput", "metricsEvery", "metricsRing"})
+		keepSetting(key);
+
+	// tiles only keep the halo sized at load around them, sensors can't reach further
+	if (tileHalo > 0 && tiledSimulation::haloFor(newSettings) > tileHalo)
+	{
+		std::cout << "Preset reload: the sensors would reach past the tile halo, 'sensorDistance' and 'sensorSize' only grow after a restart." << std::endl;
+		for (const char *key : {"sensorDistance", "sensorSize"})
+		{
+			if (settingsJson.contains(key))
+				newSettings[key] = settingsJson[key];
+			else
+				newSettings.erase(key);
+		}
+	}
+
+	// the population rules change while running, turning the dynamic
+	// population on or off needs other buffers, passes and shaders
+	if (dynamicPopulation(newSettings) != dynamicPopulation(settingsJson))
+	{
+		for (const char *key : {"targetAgents", "agentLifetime", "starveSteps"})
+			if (newSettings.contains(key) != settingsJson.contains(key))
+				keepSetting(key);
+	}
+
+	// the modes of single maps need stageFinal, switching the shader would
+	// turn some on or off while their buffers and passes stay as loaded
+	auto singleMapModes = [](const json &preset)
+	{
+		return std::vector<bool>{sparseTiles(preset), dynamicPopulation(preset), mipSensing(preset), satSensing(preset),
+			headingVectors(preset), packedAgents(preset), measuredMetrics(preset)};
+	};
+	if (!tiledSimulation::needsTiles(settingsJson) && singleMapModes(newSettings) != singleMapModes(settingsJson))
+		keepSetting("simulationShader");
+
+	if (newSettings["simulationShader"] != settingsJson["simulationShader"])
+		shaderChanged = true;
+
+	try
+	{
+		applySettings(newSettings);
+	}
+	catch (json::exception &e)
+	{
+		std::cout << "Preset reload failed: " << e.what() << std::endl;
+		return;
+	}
+
+	settingsJson = newSettings;
+	std::cout << "Preset reloaded." << std::endl;
 }
 
 void framebufferSizeCallback(GLFWwindow *window, int width, int height)
 {
+	// the simulation and the drawn image keep their size, the frame loop
+	// scales the image to the new framebuffer size
 	glViewport(0, 0, width, height);
 }  
 
@@ -460,10 +597,16 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
 	// fullscreen
 	if (key == GLFW_KEY_F && action == GLFW_PRESS)
 	{
+		// fullscreen keeps the monitor's video mode, the image is scaled to it
 		if (!PROGRAM_SETTINGS.fullscreen)
 		{
+			GLFWmonitor *monitor = getCurrentMonitor(window);
+			if (monitor == NULL)
+				monitor = glfwGetPrimaryMonitor();
+			const GLFWvidmode *mode = glfwGetVideoMode(monitor);
+
 			PROGRAM_SETTINGS.fullscreen = true;
-			glfwSetWindowMonitor(window, getCurrentMonitor(window), 0, 0, PROGRAM_SETTINGS.width, PROGRAM_SETTINGS.height, GLFW_DONT_CARE);
+			glfwSetWindowMonitor(window, monitor, 0, 0, mode->width, mode->height, mode->refreshRate);
 
 		} else
 		{
@@ -0,0 +1,47 @@
+#version 450 core
+out vec4 FragColor;
+
+#include "settings.glsl"
+#include "trail.glsl"
+
+// map pixels per display pixel
+uniform vec2 mapScale;
+
+// most map pixels averaged per display pixel along each axis
+#define MAX_SAMPLES 4
+
+// color of one map pixel, the agent color where an agent deposited
+vec4 mapColor(ivec2 coord)
+{
+	#ifdef TILED
+	selectTile(coord);
+	#endif
+
+	if (loadDeposits(coord) > 0)
+	{
+		return agentColor();
+	}
+	return displayTrail(coord);
+}
+
+void main()
+{
+	// shows the trail (and agents) without changing it, a display pixel
+	// covering several map pixels averages up to MAX_SAMPLES x MAX_SAMPLES of
+	// them so shrunk maps don't flicker, one covering less picks the nearest
+	vec2 corner = (gl_FragCoord.xy - 0.5) * mapScale;
+	ivec2 samples = clamp(ivec2(ceil(mapScale)), ivec2(1), ivec2(MAX_SAMPLES));
+	ivec2 lastPixel = ivec2(settings.width-1, settings.height-1);
+
+	vec4 color = vec4(0);
+	for (int y = 0; y < samples.y; y++)
+	{
+		for (int x = 0; x < samples.x; x++)
+		{
+			vec2 position = corner + (vec2(x, y) + 0.5) / vec2(samples) * mapScale;
+			color += mapColor(min(ivec2(position), lastPixel));
+		}
+	}
+
+	FragColor = color / float(samples.x * samples.y);
+}
@@ -0,0 +1,19 @@
+// per step statistics of single maps, reduced by metrics.comp (the edge
+// resets are counted by the agent pass) and copied out by stepMetrics in
+// lib/metrics.h, has to match metricsBlock there
+#define METRIC_DENSITY_CELLS 8 // agents are counted in 8x8 regions of the map
+#define METRIC_HEADING_BINS 16 // and in 16 heading directions
+
+// intensity (average of r, g and b) a covered pixel has to exceed, the same
+// as in trailMetrics() in lib/sweep.h
+#define METRIC_COVERED 0.01
+
+layout (std430, binding = 20) buffer metricsBuffer
+{
+	float mass;   // summed intensity of the trail
+	uint covered; // pixels above METRIC_COVERED
+	uint agents;  // agents in the histograms
+	uint resets;  // agents put back on the map after hitting its edge, since the last readback
+	uint density[METRIC_DENSITY_CELLS * METRIC_DENSITY_CELLS];
+	uint headings[METRIC_HEADING_BINS];
+};
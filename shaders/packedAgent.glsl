@@ -0,0 +1,26 @@
+// agents packed into 8 bytes, for shaders built with PACKED_AGENTS, has to
+// match packAgent() in lib/simulation.h
+// x and y are 16.8 fixed point in the low 24 bits of their word (maps up to
+// 65536 pixels, 1/256 pixel steps), the angle is 16 bits of a full turn with
+// its high byte on top of x and its low byte on top of y
+// needs PI and the angle layout of agent
+
+#define AGENT_POSITION_SCALE 256.0
+#define AGENT_ANGLE_STEPS 65536.0
+
+uvec2 packAgent(agent unpacked)
+{
+	uvec2 position = uvec2(clamp(vec2(unpacked.x, unpacked.y) * AGENT_POSITION_SCALE + 0.5, vec2(0), vec2(16777215.0)));
+	uint angle = uint(fract(unpacked.angle / (2 * PI)) * AGENT_ANGLE_STEPS + 0.5) & 0xFFFFu;
+
+	return position | (uvec2(angle >> 8, angle & 0xFFu) << 24);
+}
+
+agent unpackAgent(uvec2 bits)
+{
+	agent unpacked;
+	unpacked.x = float(bits.x & 0xFFFFFFu) / AGENT_POSITION_SCALE;
+	unpacked.y = float(bits.y & 0xFFFFFFu) / AGENT_POSITION_SCALE;
+	unpacked.angle = float(((bits.x >> 24) << 8) | (bits.y >> 24)) * (2 * PI / AGENT_ANGLE_STEPS);
+	return unpacked;
+}
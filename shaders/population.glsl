@@ -0,0 +1,36 @@
+// dynamic agent population of single maps: agents live in the first
+// liveCount slots of the agent buffer, every step the agent pass marks which
+// of them survive and population.comp compacts the survivors (keeping their
+// order) and spawns new agents after them, the count never leaves the GPU
+
+// indirect dispatch arguments of the agent pass followed by the counts
+layout (std430, binding = 13) buffer populationBuffer
+{
+	uint agentGroupsX;
+	uint agentGroupsY;
+	uint agentGroupsZ;
+	uint liveCount;
+	uint survivors; // agents kept by the last compaction, new ones come after
+};
+
+// per agent state the despawn rules need, moved along with the agents
+struct agentLifeStruct {
+	uint age;     // steps since the agent spawned
+	uint starved; // steps in a row all three sensors read no trail
+};
+layout (std430, binding = 14) buffer lifeBuffer
+{
+	agentLifeStruct life[];
+};
+
+// 1 for agents that live on, written by the agent pass
+layout (std430, binding = 15) buffer aliveBuffer
+{
+	uint alive[];
+};
+
+// agents past the target despawn, missing ones spawn, the other two
+// rules are off when 0
+uniform uint targetAgents;
+uniform uint agentLifetime; // steps an agent lives
+uniform uint starveSteps;   // steps in a row an agent survives sensing nothing
@@ -0,0 +1,51 @@
+// setting SSBO struct, has to match simulationSettings in lib/simulation.h
+struct settingsStruct {
+	// agent settings
+	// --------------
+	float moveSpeed;
+	float turnSpeed;
+	float sensorAngle;
+	float sensorDistance;
+
+	// map size settings
+	// ------------
+	int width;
+	int height;
+
+	// diffusion and decay settings
+	// ----------------------------
+	float color_r;
+	float color_g;
+	float color_b;
+	float decayRate;
+	float diffuseRate;
+
+	// sensing settings
+	// ----------------
+	int sensorSize; // the sensed box reaches this many pixels around its centre
+};
+
+#ifdef BATCHED
+// batched runs keep one settings struct and random seed per simulation,
+// the struct of the simulation being worked on is copied into settings
+layout (std430, binding = 3) buffer settingsBuffer
+{
+	settingsStruct batchSettings[];
+};
+
+struct batchInfoStruct {
+	uint seed;
+	uint firstAgent;
+};
+layout (std430, binding = 6) buffer batchInfoBuffer
+{
+	batchInfoStruct batchInfo[];
+};
+
+settingsStruct settings;
+#else
+layout (std430, binding = 3) buffer settingsBuffer
+{
+	settingsStruct settings;
+};
+#endif
@@ -0,0 +1,42 @@
+// sparse diffusion of single maps: the map is split into 8x8 pixel tiles and
+// only tiles on the active list are blurred and decayed, every tile off the
+// list is zero in both trail textures
+// needs settings.glsl included before it
+#define TILE_SIZE 8
+
+// set during a step, trail when the tile's diffused trail isn't zero,
+// deposits when an agent deposited in it
+struct tileFlagsStruct {
+	uint trail;
+	uint deposits;
+};
+layout (std430, binding = 10) buffer tileFlagBuffer
+{
+	tileFlagsStruct tileFlags[];
+};
+
+// trail flag of the step before, so a tile only stops once both trails are zero
+layout (std430, binding = 11) buffer tileHistoryBuffer
+{
+	uint tileHistory[];
+};
+
+// indirect dispatch arguments followed by the tiles to diffuse next step
+layout (std430, binding = 12) buffer activeTileBuffer
+{
+	uint groupsX;
+	uint groupsY;
+	uint groupsZ;
+	uint activeTiles[];
+};
+
+ivec2 tileCount()
+{
+	return (ivec2(settings.width, settings.height) + TILE_SIZE - 1) / TILE_SIZE;
+}
+
+uint tileIndex(ivec2 coord)
+{
+	ivec2 tile = coord / TILE_SIZE;
+	return uint(tile.y * tileCount().x + tile.x);
+}
@@ -0,0 +1,175 @@
+// image textures used, the trail is ping-ponged between trailMap and nextTrailMap
+// so that the blur never reads a pixel another invocation already wrote,
+// batched runs keep one layer per simulation in array textures and tiled
+// runs one layer per tile
+// needs settings.glsl included before it
+#if defined(BATCHED)
+layout (binding = 1, rgba32f) uniform image2DArray trailMap;
+layout (binding = 2, r32ui) uniform uimage2DArray depositMap;
+layout (binding = 5, rgba32f) uniform image2DArray nextTrailMap;
+
+// layer of the simulation being worked on
+int layer;
+#define TRAIL_COORD(coord) ivec3(coord, layer)
+#elif defined(TILED)
+// tiled maps only store the trail intensity, every layer is a tile plus a
+// halo around it holding copies of the neighbouring tiles' edges
+layout (binding = 1, r16f) uniform image2DArray trailMap;
+layout (binding = 2, r32ui) uniform uimage2DArray depositMap;
+layout (binding = 5, r16f) uniform image2DArray nextTrailMap;
+
+uniform int tileSize;
+uniform int tileHalo;
+uniform ivec2 tileCount;
+
+// part of the map the tiles cover, all of it unless the map is split
+// between processes
+uniform ivec2 regionOrigin;
+uniform ivec2 regionEnd;
+
+// tile being worked on, map coordinates are read from its layer
+// which works as long as they are at most tileHalo pixels outside of it
+int layer;
+ivec2 tileOrigin;
+
+void selectTile(ivec2 coord)
+{
+	ivec2 tile = clamp((coord - regionOrigin) / tileSize, ivec2(0), tileCount - 1);
+	layer = tile.y * tileCount.x + tile.x;
+	tileOrigin = regionOrigin + tile * tileSize;
+}
+
+void selectLayer(int tileLayer)
+{
+	layer = tileLayer;
+	tileOrigin = regionOrigin + ivec2(layer % tileCount.x, layer / tileCount.x) * tileSize;
+}
+
+#define TRAIL_COORD(coord) ivec3((coord) - tileOrigin + tileHalo, layer)
+#else
+layout (binding = 1, rgba32f) uniform image2D trailMap;
+layout (binding = 2, r32ui) uniform uimage2D depositMap;
+layout (binding = 5, rgba32f) uniform image2D nextTrailMap;
+
+#define TRAIL_COORD(coord) (coord)
+#endif
+
+vec4 loadTrail(ivec2 coord)
+{
+	#ifdef TILED
+	return vec4(imageLoad(trailMap, TRAIL_COORD(coord)).r);
+	#else
+	return imageLoad(trailMap, TRAIL_COORD(coord)).rgba;
+	#endif
+}
+
+uint loadDeposits(ivec2 coord)
+{
+	return imageLoad(depositMap, TRAIL_COORD(coord)).r;
+}
+
+void countDeposit(ivec2 coord)
+{
+	imageAtomicAdd(depositMap, TRAIL_COORD(coord), 1u);
+}
+
+vec4 agentColor()
+{
+	return vec4(settings.color_r, settings.color_g, settings.color_b, 1);
+}
+
+vec4 trailColor()
+{
+	// full strength trail, tiled maps store intensity and color it when displayed
+	#ifdef TILED
+	return vec4(1);
+	#else
+	return agentColor();
+	#endif
+}
+
+vec4 displayTrail(ivec2 coord)
+{
+	// displayed color of the trail at coord
+	#ifdef TILED
+	return vec4(agentColor().rgb * loadTrail(coord).r, 1);
+	#else
+	return loadTrail(coord);
+	#endif
+}
+
+vec4 depositedTrail(ivec2 coord)
+{
+	// trail with the deposits counted by the agent pass added to it, the same
+	// value as adding them one by one since every deposit is clamped to trailColor
+	vec4 trail = loadTrail(coord);
+	uint count = loadDeposits(coord);
+
+	if (count == 0)
+	{
+		return trail;
+	}
+
+	vec4 deposit = vec4(trailColor()/5);
+	deposit.a = 1;
+
+	return min(trail + deposit * min(count, 5u), trailColor());
+}
+
+vec4 diffuseTrail(ivec2 coord)
+{
+	// blurs and decays the trail at coord, stores the result in nextTrailMap
+	// and returns it before clamping (which is what gets displayed)
+	int width = settings.width;
+	int height = settings.height;
+
+	float decayRate = settings.decayRate;
+	float diffuseRate = settings.diffuseRate;
+	// -------------------------------------
+
+
+	// get original color for each pixel(fragment)
+	vec4 originalColor = depositedTrail(coord);
+	
+
+	// box blur by sampling 3x3 area around the current fragment(pixel)
+	// adding up all of the area color values and dividing them by 9
+	// ----------------------------------------------------------------
+	vec4 blurredColor = vec4(0);
+	int totalWeight = 0;
+	for(int offsetX = -1; offsetX <= 1; offsetX++)
+	{
+		for(int offsetY = -1; offsetY <= 1; offsetY++)
+		{
+			
+			// bound checking for sample coords
+			int sampleX = min(width-1, max(0, coord.x+offsetX));
+			int sampleY = min(height-1, max(0, coord.y+offsetY));
+
+			// using imageLoad
+			blurredColor += depositedTrail(ivec2(sampleX, sampleY));
+			totalWeight+= 1;
+		}
+	}
+
+	blurredColor /= totalWeight;
+
+	float diffuseWeight = clamp(diffuseRate, 0, 1);
+
+
+	// the new color (calculatedTrailColor) is composed out of originalColor 
+	// and blurredColor, using diffuseWeight as the ratio
+	vec4 calculatedTrailColor = originalColor * (1 - diffuseWeight) + blurredColor * diffuseWeight;
+
+	// apply decay to color value
+	calculatedTrailColor = calculatedTrailColor - decayRate;
+
+	// fix alpha channel (has to always be 1)
+	calculatedTrailColor.a = 1;
+	
+
+	// store blurred + decayed trail in nextTrailMap
+	imageStore(nextTrailMap, TRAIL_COORD(coord), max(calculatedTrailColor, 0.0f));
+
+	return calculatedTrailColor;
+}